@@ -0,0 +1,78 @@
+/**
+ * Packed test asset archive format
+ * Copyright (C) 2010 Nokia
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * The archive starts with a header, followed by an index of entryCount
+ * entries and the asset data. All fields are stored in host byte order, so
+ * the archive must be generated for the target it is used on.
+ *
+ * KTX (version 1) texture containers may be stored in the archive as is. Their
+ * header layout is also described here.
+ */
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include <stdint.h>
+
+#define ASSET_ARCHIVE_NAME      "assets.pak"
+#define ASSET_ARCHIVE_MAGIC     "EGLXPAK1"
+#define ASSET_NAME_LENGTH       64
+#define ASSET_DATA_ALIGNMENT    64
+
+/** Archive header */
+struct AssetArchiveHeader
+{
+    char magic[8];                      /** ASSET_ARCHIVE_MAGIC */
+    uint32_t entryCount;                /** Number of index entries */
+    uint32_t reserved;
+};
+
+/** Archive index entry */
+struct AssetArchiveEntry
+{
+    char name[ASSET_NAME_LENGTH];       /** NUL-terminated file name */
+    uint32_t format;                    /** GL format or 0 if unknown */
+    uint32_t type;                      /** GL type, 0 for compressed data */
+    uint32_t width;                     /** Width in pixels */
+    uint32_t height;                    /** Height in pixels */
+    uint32_t offset;                    /** Data offset from start of archive */
+    uint32_t size;                      /** Data size in bytes */
+};
+
+#define KTX_IDENTIFIER          "\xabKTX 11\xbb\r\n\x1a\n"
+#define KTX_ENDIANNESS          0x04030201
+
+/** KTX file header, followed by key/value data and the mipmap levels */
+struct KTXHeader
+{
+    uint8_t identifier[12];             /** KTX_IDENTIFIER */
+    uint32_t endianness;                /** KTX_ENDIANNESS in writer byte order */
+    uint32_t glType;                    /** GL type, 0 for compressed data */
+    uint32_t glTypeSize;                /** Size of glType in bytes */
+    uint32_t glFormat;                  /** GL format, 0 for compressed data */
+    uint32_t glInternalFormat;          /** GL internal format */
+    uint32_t glBaseInternalFormat;      /** GL base internal format */
+    uint32_t pixelWidth;                /** Width of level 0 in pixels */
+    uint32_t pixelHeight;               /** Height of level 0 in pixels */
+    uint32_t pixelDepth;                /** 0 for 2D textures */
+    uint32_t numberOfArrayElements;     /** 0 for non-array textures */
+    uint32_t numberOfFaces;             /** 1 for non-cubemap textures */
+    uint32_t numberOfMipmapLevels;      /** 0 if mipmaps should be generated */
+    uint32_t bytesOfKeyValueData;       /** Size of the key/value data */
+};
+
+#endif // ASSETS_H
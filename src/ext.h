@@ -145,4 +145,18 @@ typedef EGLBoolean (EGLAPIENTRYP PFNEGLSETSURFACESCALINGNOKPROC) (EGLDisplay dis
 #define EGL_SYNC_FENCE_KHR                      0x30F9
 #endif
 
+#ifndef EGL_KHR_wait_sync
+#define EGL_KHR_wait_sync 1
+typedef EGLint (EGLAPIENTRYP PFNEGLWAITSYNCKHRPROC) (EGLDisplay dpy, EGLSyncKHR sync, EGLint flags);
+#endif
+
+#ifndef EGL_ANDROID_native_fence_sync
+#define EGL_ANDROID_native_fence_sync 1
+#define EGL_SYNC_NATIVE_FENCE_ANDROID           0x3144
+#define EGL_SYNC_NATIVE_FENCE_FD_ANDROID        0x3145
+#define EGL_SYNC_NATIVE_FENCE_SIGNALED_ANDROID  0x3146
+#define EGL_NO_NATIVE_FENCE_FD_ANDROID          -1
+typedef EGLint (EGLAPIENTRYP PFNEGLDUPNATIVEFENCEFDANDROIDPROC) (EGLDisplay dpy, EGLSyncKHR sync);
+#endif
+
 #endif // EXT_H
@@ -0,0 +1,232 @@
+/**
+ * Packed test asset archive generator
+ * Copyright (C) 2010 Nokia
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Usage: mkassets OUTPUT INPUT...
+ *
+ * Texture metadata is derived from file names of the form
+ * <name>_<width>x<height>_<format>.raw, where <format> is one of the names
+ * returned by util::textureFormatName(). The metadata of KTX files is read
+ * from their header. Other files are stored without metadata.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include <string>
+#include <vector>
+
+#include "assets.h"
+
+static const struct
+{
+    const char* name;
+    GLenum format;
+    GLenum type;
+    int bitsPerPixel;
+} formats[] =
+{
+    {"r8",          GL_LUMINANCE,       GL_UNSIGNED_BYTE,           8},
+    {"a8",          GL_ALPHA,           GL_UNSIGNED_BYTE,           8},
+    {"rgb888",      GL_RGB,             GL_UNSIGNED_BYTE,           24},
+    {"rgba8888",    GL_RGBA,            GL_UNSIGNED_BYTE,           32},
+    {"rgb565",      GL_RGB,             GL_UNSIGNED_SHORT_5_6_5,    16},
+    {"rgba4444",    GL_RGBA,            GL_UNSIGNED_SHORT_4_4_4_4,  16},
+    {"rgba5551",    GL_RGBA,            GL_UNSIGNED_SHORT_5_5_5_1,  16},
+    {"rgba1555",    GL_RGBA,            GL_UNSIGNED_SHORT_5_5_5_1,  16},
+    {"etc1",        GL_ETC1_RGB8_OES,   0,                          4},
+};
+
+static void parseMetadata(const std::string& name, AssetArchiveEntry& entry)
+{
+    size_t ext = name.rfind(".raw");
+    size_t sep = name.rfind('_');
+
+    if (ext == std::string::npos || sep == std::string::npos || sep == 0)
+    {
+        return;
+    }
+
+    std::string format = name.substr(sep + 1, ext - sep - 1);
+    size_t sizeSep = name.rfind('_', sep - 1);
+    unsigned width, height;
+
+    if (sizeSep == std::string::npos ||
+        sscanf(name.c_str() + sizeSep + 1, "%ux%u_", &width, &height) != 2)
+    {
+        return;
+    }
+
+    for (unsigned i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        if (format == formats[i].name)
+        {
+            size_t expected = (size_t)width * height * formats[i].bitsPerPixel / 8;
+            if (formats[i].type == 0)
+            {
+                expected = ((width + 3) / 4) * ((height + 3) / 4) * 8;
+            }
+            /* Files may carry extra data such as a mipmap chain */
+            if (expected > entry.size)
+            {
+                fprintf(stderr, "Warning: %s: expected %zu bytes, got %u\n",
+                        name.c_str(), expected, entry.size);
+            }
+            entry.format = formats[i].format;
+            entry.type = formats[i].type;
+            entry.width = width;
+            entry.height = height;
+            return;
+        }
+    }
+}
+
+static void parseKTXMetadata(const std::vector<char>& data, AssetArchiveEntry& entry)
+{
+    KTXHeader header;
+
+    if (data.size() < sizeof(header))
+    {
+        return;
+    }
+
+    memcpy(&header, &data[0], sizeof(header));
+
+    /* Only native byte order headers are indexed */
+    if (memcmp(header.identifier, KTX_IDENTIFIER, sizeof(header.identifier)) ||
+        header.endianness != KTX_ENDIANNESS)
+    {
+        return;
+    }
+
+    entry.format = header.glType ? header.glFormat : header.glInternalFormat;
+    entry.type = header.glType;
+    entry.width = header.pixelWidth;
+    entry.height = header.pixelHeight;
+}
+
+static bool readFile(const char* fileName, std::vector<char>& data)
+{
+    FILE* f = fopen(fileName, "rb");
+
+    if (!f)
+    {
+        perror(fileName);
+        return false;
+    }
+
+    fseek(f, 0, SEEK_END);
+    data.resize(ftell(f));
+    fseek(f, 0, SEEK_SET);
+
+    if (data.size() && fread(&data[0], data.size(), 1, f) != 1)
+    {
+        perror(fileName);
+        fclose(f);
+        return false;
+    }
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s OUTPUT INPUT...\n", argv[0]);
+        return 1;
+    }
+
+    int count = argc - 2;
+    std::vector<AssetArchiveEntry> entries(count);
+    std::vector<std::vector<char> > contents(count);
+    size_t offset = sizeof(AssetArchiveHeader) + count * sizeof(AssetArchiveEntry);
+
+    for (int i = 0; i < count; i++)
+    {
+        const char* path = argv[i + 2];
+        const char* base = strrchr(path, '/');
+        std::string name = base ? base + 1 : path;
+
+        if (name.size() >= ASSET_NAME_LENGTH)
+        {
+            fprintf(stderr, "%s: name too long\n", path);
+            return 1;
+        }
+
+        if (!readFile(path, contents[i]))
+        {
+            return 1;
+        }
+
+        offset = (offset + ASSET_DATA_ALIGNMENT - 1) & ~(ASSET_DATA_ALIGNMENT - 1);
+
+        AssetArchiveEntry& entry = entries[i];
+        memset(&entry, 0, sizeof(entry));
+        strcpy(entry.name, name.c_str());
+        entry.offset = offset;
+        entry.size = contents[i].size();
+
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".ktx") == 0)
+        {
+            parseKTXMetadata(contents[i], entry);
+        }
+        else
+        {
+            parseMetadata(name, entry);
+        }
+
+        offset += entry.size;
+    }
+
+    FILE* out = fopen(argv[1], "wb");
+    if (!out)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+
+    AssetArchiveHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ASSET_ARCHIVE_MAGIC, sizeof(header.magic));
+    header.entryCount = count;
+
+    fwrite(&header, sizeof(header), 1, out);
+    fwrite(&entries[0], sizeof(AssetArchiveEntry), count, out);
+
+    for (int i = 0; i < count; i++)
+    {
+        static const char padding[ASSET_DATA_ALIGNMENT] = {0};
+        long pos = ftell(out);
+
+        fwrite(padding, entries[i].offset - pos, 1, out);
+        if (contents[i].size())
+        {
+            fwrite(&contents[i][0], contents[i].size(), 1, out);
+        }
+    }
+
+    if (fclose(out))
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    return 0;
+}
@@ -20,6 +20,7 @@
  * Native windowing
  */
 #include <EGL/egl.h>
+#include <stddef.h>
 
 #if defined(__cplusplus)
 extern "C" {
@@ -101,6 +102,59 @@ EGLBoolean nativeCreatePixmap(EGLNativeDisplayType nativeDisplay,
  */
 void nativeDestroyPixmap(EGLNativeDisplayType nativeDisplay, EGLNativePixmapType nativePixmap);
 
+/**
+ *  Get a native pixmap from the pixmap pool. An idle pooled pixmap with a
+ *  matching display, size and depth is reused if one is available, otherwise
+ *  a new pixmap is created. The contents of a recycled pixmap are undefined.
+ *  Pooled pixmaps of a display are released when the display is destroyed.
+ *
+ *  @param nativeDisplay                Native display handle
+ *  @param depth                        Color depth
+ *  @param width                        Pixmap width in pixels
+ *  @param height                       Pixmap height in pixels
+ *  @param[out] nativePixmap            Pixmap handle
+ */
+EGLBoolean nativeCreatePooledPixmap(EGLNativeDisplayType nativeDisplay,
+                                    int depth,
+                                    int width, int height, EGLNativePixmapType *nativePixmap);
+
+/**
+ *  Return a pixmap obtained with nativeCreatePooledPixmap() to the pool. Least
+ *  recently used idle pixmaps are destroyed if the pool grows over its memory
+ *  limit.
+ *
+ *  @param nativeDisplay                Native display handle
+ *  @param nativePixmap                 Pixmap to release
+ */
+void nativeReleasePooledPixmap(EGLNativeDisplayType nativeDisplay, EGLNativePixmapType nativePixmap);
+
+/**
+ *  Set the upper limit for the memory held by the idle pooled pixmaps of each
+ *  display
+ *
+ *  @param nativeDisplay                Native display handle
+ *  @param maxBytes                     Memory limit in bytes
+ */
+void nativeSetPixmapPoolLimit(EGLNativeDisplayType nativeDisplay, size_t maxBytes);
+
+/**
+ *  Query the number of idle pixmaps of a display in the pool and the memory
+ *  held by them
+ *
+ *  @param nativeDisplay                Native display handle
+ *  @param[out] idleCount               Number of idle pixmaps
+ *  @param[out] idleBytes               Memory used by idle pixmaps in bytes
+ */
+void nativeGetPixmapPoolUsage(EGLNativeDisplayType nativeDisplay, int *idleCount,
+                              size_t *idleBytes);
+
+/**
+ *  Destroy all idle pixmaps of a display in the pool
+ *
+ *  @param nativeDisplay                Native display handle
+ */
+void nativeFlushPixmapPool(EGLNativeDisplayType nativeDisplay);
+
 /** Opaque native front buffer handle */
 typedef void* NativeFrontBuffer;
 
@@ -26,6 +26,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <assert.h>
+#include <pthread.h>
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
@@ -48,8 +49,11 @@ EGLBoolean nativeCreateDisplay(EGLNativeDisplayType *pNativeDisplay)
     return EGL_TRUE;
 }
 
+static void forgetPooledPixmaps(EGLNativeDisplayType nativeDisplay);
+
 void nativeDestroyDisplay(EGLNativeDisplayType nativeDisplay)
 {
+    forgetPooledPixmaps(nativeDisplay);
     XCloseDisplay(nativeDisplay);
 }
 
@@ -263,6 +267,216 @@ void nativeDestroyPixmap(EGLNativeDisplayType nativeDisplay, EGLNativePixmapType
     XFreePixmap(nativeDisplay, nativePixmap);
 }
 
+/*
+ * Pixmap pool. Entries are kept in release order so that the first idle entry
+ * is always the least recently used one. Pixmap IDs are only valid on the
+ * display connection that created them, so every entry records its display
+ * and is only matched, trimmed and freed on that display.
+ */
+typedef struct
+{
+    EGLNativeDisplayType display;
+    Pixmap pixmap;
+    int width;
+    int height;
+    int depth;
+    size_t size;
+    int inUse;
+} PooledPixmap;
+
+static PooledPixmap *pool = NULL;
+static int poolCount = 0;
+static int poolCapacity = 0;
+static size_t poolLimit = 32 * 1024 * 1024;
+static pthread_mutex_t poolLock = PTHREAD_MUTEX_INITIALIZER;
+
+static size_t pixmapSize(int width, int height, int depth)
+{
+    int bytesPerPixel = (depth <= 8) ? 1 : ((depth <= 16) ? 2 : 4);
+    return (size_t)width * height * bytesPerPixel;
+}
+
+static void removePoolEntry(int index)
+{
+    memmove(&pool[index], &pool[index + 1],
+            (poolCount - index - 1) * sizeof(PooledPixmap));
+    poolCount--;
+}
+
+/* Must be called with the pool lock held */
+static void trimPool(EGLNativeDisplayType nativeDisplay, size_t maxBytes)
+{
+    size_t idleBytes = 0;
+    int i;
+
+    for (i = 0; i < poolCount; i++)
+    {
+        if (pool[i].display == nativeDisplay && !pool[i].inUse)
+        {
+            idleBytes += pool[i].size;
+        }
+    }
+
+    for (i = 0; i < poolCount && idleBytes > maxBytes;)
+    {
+        if (pool[i].display != nativeDisplay || pool[i].inUse)
+        {
+            i++;
+            continue;
+        }
+        idleBytes -= pool[i].size;
+        XFreePixmap(nativeDisplay, pool[i].pixmap);
+        removePoolEntry(i);
+    }
+}
+
+EGLBoolean nativeCreatePooledPixmap(EGLNativeDisplayType nativeDisplay, int depth,
+                                    int width, int height, EGLNativePixmapType *nativePixmap)
+{
+    int i;
+
+    pthread_mutex_lock(&poolLock);
+    for (i = poolCount - 1; i >= 0; i--)
+    {
+        if (pool[i].display == nativeDisplay && !pool[i].inUse &&
+            pool[i].width == width && pool[i].height == height &&
+            pool[i].depth == depth)
+        {
+            pool[i].inUse = 1;
+            *nativePixmap = pool[i].pixmap;
+            pthread_mutex_unlock(&poolLock);
+            return EGL_TRUE;
+        }
+    }
+    pthread_mutex_unlock(&poolLock);
+
+    if (!nativeCreatePixmap(nativeDisplay, depth, width, height, nativePixmap))
+    {
+        return EGL_FALSE;
+    }
+
+    pthread_mutex_lock(&poolLock);
+    if (poolCount == poolCapacity)
+    {
+        PooledPixmap *newPool;
+        int newCapacity = poolCapacity ? 2 * poolCapacity : 16;
+
+        newPool = realloc(pool, newCapacity * sizeof(PooledPixmap));
+        if (!newPool)
+        {
+            pthread_mutex_unlock(&poolLock);
+            fprintf(stderr, "Unable to grow pixmap pool\n");
+            XFreePixmap(nativeDisplay, *nativePixmap);
+            return EGL_FALSE;
+        }
+        pool = newPool;
+        poolCapacity = newCapacity;
+    }
+
+    pool[poolCount].display = nativeDisplay;
+    pool[poolCount].pixmap = *nativePixmap;
+    pool[poolCount].width = width;
+    pool[poolCount].height = height;
+    pool[poolCount].depth = depth;
+    pool[poolCount].size = pixmapSize(width, height, depth);
+    pool[poolCount].inUse = 1;
+    poolCount++;
+    pthread_mutex_unlock(&poolLock);
+
+    return EGL_TRUE;
+}
+
+void nativeReleasePooledPixmap(EGLNativeDisplayType nativeDisplay, EGLNativePixmapType nativePixmap)
+{
+    PooledPixmap entry;
+    int i;
+
+    pthread_mutex_lock(&poolLock);
+    for (i = 0; i < poolCount; i++)
+    {
+        if (pool[i].display == nativeDisplay && pool[i].pixmap == nativePixmap &&
+            pool[i].inUse)
+        {
+            break;
+        }
+    }
+
+    if (i == poolCount)
+    {
+        /* Not a pooled pixmap */
+        pthread_mutex_unlock(&poolLock);
+        XFreePixmap(nativeDisplay, nativePixmap);
+        return;
+    }
+
+    /* Move the entry to the most recently used end of the pool */
+    entry = pool[i];
+    entry.inUse = 0;
+    removePoolEntry(i);
+    pool[poolCount++] = entry;
+
+    trimPool(nativeDisplay, poolLimit);
+    pthread_mutex_unlock(&poolLock);
+}
+
+void nativeSetPixmapPoolLimit(EGLNativeDisplayType nativeDisplay, size_t maxBytes)
+{
+    pthread_mutex_lock(&poolLock);
+    poolLimit = maxBytes;
+    trimPool(nativeDisplay, poolLimit);
+    pthread_mutex_unlock(&poolLock);
+}
+
+void nativeGetPixmapPoolUsage(EGLNativeDisplayType nativeDisplay, int *idleCount,
+                              size_t *idleBytes)
+{
+    int i;
+
+    *idleCount = 0;
+    *idleBytes = 0;
+
+    pthread_mutex_lock(&poolLock);
+    for (i = 0; i < poolCount; i++)
+    {
+        if (pool[i].display == nativeDisplay && !pool[i].inUse)
+        {
+            (*idleCount)++;
+            *idleBytes += pool[i].size;
+        }
+    }
+    pthread_mutex_unlock(&poolLock);
+}
+
+void nativeFlushPixmapPool(EGLNativeDisplayType nativeDisplay)
+{
+    pthread_mutex_lock(&poolLock);
+    trimPool(nativeDisplay, 0);
+    pthread_mutex_unlock(&poolLock);
+}
+
+/*
+ * Drop all pool entries of a display that is about to be closed. Idle pixmaps
+ * are freed. Pixmaps still in use die with the connection, so their entries
+ * are simply removed.
+ */
+static void forgetPooledPixmaps(EGLNativeDisplayType nativeDisplay)
+{
+    int i;
+
+    pthread_mutex_lock(&poolLock);
+    trimPool(nativeDisplay, 0);
+    for (i = 0; i < poolCount;)
+    {
+        if (pool[i].display == nativeDisplay)
+        {
+            removePoolEntry(i);
+            continue;
+        }
+        i++;
+    }
+    pthread_mutex_unlock(&poolLock);
+}
+
 EGLBoolean nativeGetDisplayProperties(EGLNativeDisplayType nativeDisplay, int *width,
                                       int *height, int *depth)
 {
@@ -21,14 +21,19 @@
  */
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <pthread.h>
 
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
 #include <boost/scoped_array.hpp>
 
+#include <algorithm>
+#include <vector>
+
 #include <string.h>
 #include <malloc.h>
 #include <fcntl.h>
@@ -54,6 +59,34 @@ static PFNEGLCREATEIMAGEKHRPROC eglCreateImageKHR;
 static PFNEGLDESTROYIMAGEKHRPROC eglDestroyImageKHR;
 static PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES;
 
+// Server wait
+static PFNEGLWAITSYNCKHRPROC eglWaitSyncKHR;
+
+/** GPU load for the latency benchmarks */
+static test::Workload* workload;
+
+/**
+ *  Calibrate the workload for the window surface at @level
+ */
+static void calibrateWorkload(test::Workload::Level level)
+{
+    EGLint width, height;
+
+    eglQuerySurface(util::ctx.dpy, util::ctx.surface, EGL_WIDTH, &width);
+    eglQuerySurface(util::ctx.dpy, util::ctx.surface, EGL_HEIGHT, &height);
+    workload->calibrate(level, width, height);
+}
+
+/**
+ *  Render one frame of the workload
+ */
+static void renderWorkload(int frame)
+{
+    glClearColor(float(frame % 16) / 16, 0.0, 0.0, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    workload->render(frame);
+}
+
 /**
  * Verify that the needed extensions are present
  */
@@ -348,14 +381,16 @@ void testSyncQueue(bool inOrder, bool acrossFrames)
 }
 
 /**
- *  Measure various delays when using sync objects
+ *  Measure various delays when using sync objects with the GPU at load
+ *  @level
  */
-void testLatency()
+void testLatency(test::Workload::Level level)
 {
     int cycles = 64;
     int64_t start, totalRendering = 0, totalCreate = 0,
             totalWait = 0, totalDestroy = 0;
 
+    calibrateWorkload(level);
     glClearColor(.8, .1, .6, 1.0);
 
     for (int i = 0; i < cycles; i++)
@@ -363,6 +398,7 @@ void testLatency()
         /* Render */
         start = util::getTime();
         glClear(GL_COLOR_BUFFER_BIT);
+        workload->render(i);
         totalRendering += util::getTime() - start;
 
         /* Place fence */
@@ -392,6 +428,956 @@ void testLatency()
             totalDestroy / cycles / 1000UL);
 }
 
+/**
+ *  Measure fence throughput as the number of outstanding fences grows.
+ *
+ *  Test loop:
+ *
+ *  1. Create @outstanding fences, each after a small scissored clear. If
+ *     @acrossFrames is set, swap buffers in between, at most 128 times over
+ *     the whole test.
+ *  2. Wait for the fences and destroy them, either in creation order or, if
+ *     @inOrder is not set, in a random order.
+ *  3. Repeat until at least 4096 fences have been processed.
+ *
+ *  The test results are the number of fences processed per second and the
+ *  average time spent in eglCreateSyncKHR, eglClientWaitSyncKHR and
+ *  eglDestroySyncKHR per fence.
+ */
+void testSyncThroughput(int outstanding, bool inOrder, bool acrossFrames)
+{
+    const int minFences = 4096;
+    int batches = (minFences + outstanding - 1) / outstanding;
+    int swapInterval = std::max(batches * outstanding / 128, 1);
+    int created = 0;
+    std::vector<EGLSyncKHR> sync(outstanding);
+    std::vector<int> order(outstanding);
+    int64_t start, totalCreate = 0, totalWait = 0, totalDestroy = 0;
+    unsigned int seed = 1;
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, 8, 8);
+
+    int64_t begin = util::getTime();
+    for (int batch = 0; batch < batches; batch++)
+    {
+        /* Render and place fences */
+        for (int i = 0; i < outstanding; i++)
+        {
+            glClearColor(0.0, 0.0, float(i + 1) / outstanding, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+
+            start = util::getTime();
+            sync[i] = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_FENCE_KHR, NULL);
+            totalCreate += util::getTime() - start;
+            ASSERT(sync[i] != EGL_NO_SYNC_KHR);
+
+            if (acrossFrames && ++created % swapInterval == 0)
+            {
+                test::swapBuffers();
+            }
+        }
+
+        /* Pick the waiting order */
+        for (int i = 0; i < outstanding; i++)
+        {
+            order[i] = i;
+        }
+        if (!inOrder)
+        {
+            for (int i = outstanding - 1; i > 0; i--)
+            {
+                seed = seed * 1103515245 + 12345;
+                std::swap(order[i], order[(seed >> 16) % (i + 1)]);
+            }
+        }
+
+        /* Wait for fences */
+        for (int i = 0; i < outstanding; i++)
+        {
+            EGLSyncKHR s = sync[order[i]];
+
+            start = util::getTime();
+            EGLint ret = eglClientWaitSyncKHR(util::ctx.dpy, s,
+                    EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 1000ull * 1000 * 1000);
+            totalWait += util::getTime() - start;
+            ASSERT(ret == EGL_CONDITION_SATISFIED_KHR);
+
+            start = util::getTime();
+            eglDestroySyncKHR(util::ctx.dpy, s);
+            totalDestroy += util::getTime() - start;
+        }
+        ASSERT_EGL();
+    }
+    int64_t time = util::getTime() - begin;
+
+    glDisable(GL_SCISSOR_TEST);
+    ASSERT_GL();
+
+    int64_t fences = (int64_t)batches * outstanding;
+    printf("%.0f fences/s, %.2f us / %.2f us / %.2f us : ",
+            fences / (time / 1e9),
+            totalCreate / 1000.0 / fences,
+            totalWait / 1000.0 / fences,
+            totalDestroy / 1000.0 / fences);
+}
+
+/** Fence queue between the render thread and the consumer thread */
+struct FencePipeline
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;             /** Signaled when a fence is queued or retired */
+    std::vector<EGLSyncKHR> fences;     /** Ring buffer of queued fences */
+    std::vector<int64_t> queueTimes;    /** Time each queued fence was flushed */
+    int head;                           /** Oldest queued fence */
+    int count;                          /** Number of queued fences */
+    int frames;                         /** Number of frames to consume, lowered on failure */
+    util::Samples latency;              /** Time from flush to consumer wakeup */
+    bool failed;                        /** Set when creating or waiting for a fence failed */
+};
+
+/**
+ *  Consumer thread for the fence pipeline benchmark
+ */
+void* fenceConsumerThread(void* data)
+{
+    FencePipeline* pipeline = reinterpret_cast<FencePipeline*>(data);
+    int depth = pipeline->fences.size();
+
+    for (int frame = 0;; frame++)
+    {
+        pthread_mutex_lock(&pipeline->lock);
+        while (!pipeline->count && frame < pipeline->frames)
+        {
+            pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+        }
+        if (frame >= pipeline->frames)
+        {
+            pthread_mutex_unlock(&pipeline->lock);
+            break;
+        }
+        EGLSyncKHR sync = pipeline->fences[pipeline->head];
+        int64_t queueTime = pipeline->queueTimes[pipeline->head];
+        pthread_mutex_unlock(&pipeline->lock);
+
+        /* The render thread has flushed, so no flush is needed here */
+        EGLint ret = eglClientWaitSyncKHR(util::ctx.dpy, sync, 0, EGL_FOREVER_KHR);
+        pipeline->latency.add(util::getTime() - queueTime);
+        eglDestroySyncKHR(util::ctx.dpy, sync);
+
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->failed |= (ret != EGL_CONDITION_SATISFIED_KHR);
+        pipeline->head = (pipeline->head + 1) % depth;
+        pipeline->count--;
+        pthread_cond_signal(&pipeline->changed);
+        pthread_mutex_unlock(&pipeline->lock);
+    }
+    return NULL;
+}
+
+/**
+ *  Measure a pipeline where one thread renders and another waits for the
+ *  rendering to complete.
+ *
+ *  Initialization:
+ *
+ *  1. Start a consumer thread.
+ *
+ *  Test loop:
+ *
+ *  1. In the render thread, wait until fewer than @depth fences are queued.
+ *  2. Render a frame, place a fence after it, flush and queue the fence.
+ *  3. In the consumer thread, wait for the oldest queued fence with
+ *     eglClientWaitSyncKHR and destroy it.
+ *
+ *  The test results are the number of frames per second and the average,
+ *  median and worst time from queueing a fence to the consumer waking up.
+ */
+void testSyncPipeline(int depth)
+{
+    const int frames = 256;
+    FencePipeline pipeline;
+    EGLint width, height;
+
+    eglQuerySurface(util::ctx.dpy, util::ctx.surface, EGL_WIDTH, &width);
+    eglQuerySurface(util::ctx.dpy, util::ctx.surface, EGL_HEIGHT, &height);
+
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.changed, NULL);
+    pipeline.fences.resize(depth);
+    pipeline.queueTimes.resize(depth);
+    pipeline.head = 0;
+    pipeline.count = 0;
+    pipeline.frames = frames;
+    pipeline.failed = false;
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, fenceConsumerThread, &pipeline);
+
+    int64_t start = util::getTime();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        pthread_mutex_lock(&pipeline.lock);
+        while (pipeline.count == depth)
+        {
+            pthread_cond_wait(&pipeline.changed, &pipeline.lock);
+        }
+        pthread_mutex_unlock(&pipeline.lock);
+
+        /* Render a frame */
+        glClearColor(0.0, float(frame % 16) / 16, 0.0, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        test::drawQuad(0, 0, width, height);
+
+        EGLSyncKHR sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_FENCE_KHR, NULL);
+        if (sync == EGL_NO_SYNC_KHR)
+        {
+            /* Let the consumer retire the fences already queued and exit */
+            pthread_mutex_lock(&pipeline.lock);
+            pipeline.frames = frame;
+            pipeline.failed = true;
+            pthread_cond_signal(&pipeline.changed);
+            pthread_mutex_unlock(&pipeline.lock);
+            break;
+        }
+        glFlush();
+        int64_t queueTime = util::getTime();
+
+        pthread_mutex_lock(&pipeline.lock);
+        int tail = (pipeline.head + pipeline.count) % depth;
+        pipeline.fences[tail] = sync;
+        pipeline.queueTimes[tail] = queueTime;
+        pipeline.count++;
+        pthread_cond_signal(&pipeline.changed);
+        pthread_mutex_unlock(&pipeline.lock);
+    }
+    pthread_join(thread, NULL);
+    int64_t time = util::getTime() - start;
+
+    pthread_cond_destroy(&pipeline.changed);
+    pthread_mutex_destroy(&pipeline.lock);
+    ASSERT_GL();
+    ASSERT_EGL();
+    ASSERT(!pipeline.failed);
+
+    printf("%.1f frames/s, %lld us latency, %lld us median, %lld us worst : ",
+            frames / (time / 1e9),
+            (long long)(pipeline.latency.mean() / 1000),
+            (long long)(pipeline.latency.percentile(50) / 1000),
+            (long long)(pipeline.latency.max() / 1000));
+}
+
+/**
+ *  Record the completion of every fence in @fences that has signaled since
+ *  the last call. Fences already seen as signaled are skipped.
+ */
+static void pollFrameFences(const std::vector<EGLSyncKHR>& fences,
+                            const std::vector<int64_t>& submitTimes,
+                            std::vector<bool>& completed, util::Samples& latency)
+{
+    for (size_t i = 0; i < fences.size(); i++)
+    {
+        if (fences[i] == EGL_NO_SYNC_KHR || completed[i])
+        {
+            continue;
+        }
+        if (eglClientWaitSyncKHR(util::ctx.dpy, fences[i], 0, 0) ==
+            EGL_CONDITION_SATISFIED_KHR)
+        {
+            latency.add(util::getTime() - submitTimes[i]);
+            completed[i] = true;
+        }
+    }
+}
+
+/**
+ *  Destroy the fences of all frames still in flight
+ */
+static void destroyFrameFences(std::vector<EGLSyncKHR>& fences)
+{
+    for (size_t i = 0; i < fences.size(); i++)
+    {
+        if (fences[i] != EGL_NO_SYNC_KHR)
+        {
+            eglDestroySyncKHR(util::ctx.dpy, fences[i]);
+            fences[i] = EGL_NO_SYNC_KHR;
+        }
+    }
+}
+
+/**
+ *  Measure throughput and latency when the number of frames in flight is
+ *  limited with fences.
+ *
+ *  Initialization:
+ *
+ *  1. Calibrate the workload to the light load level.
+ *  2. Disable swap throttling so that the GPU, not the display refresh rate,
+ *     limits the frame rate.
+ *
+ *  Test loop:
+ *
+ *  1. If @framesInFlight frames are already in flight and the oldest one has
+ *     not been seen to complete, wait for its fence. Destroy the fence.
+ *  2. Render a frame of the workload, place a fence after it and swap
+ *     buffers.
+ *  3. Poll the fences of all frames in flight without blocking and record
+ *     the completion of those that have signaled.
+ *
+ *  The test results are the number of frames per second, the process CPU time
+ *  per frame and the average and 99th percentile time from swapping a frame
+ *  to its fence being seen as signaled.
+ */
+void testFramePacing(int framesInFlight)
+{
+    const int frames = 128;
+    std::vector<EGLSyncKHR> fences(framesInFlight, EGL_NO_SYNC_KHR);
+    std::vector<int64_t> submitTimes(framesInFlight);
+    std::vector<bool> completed(framesInFlight, false);
+    util::Samples latency;
+
+    calibrateWorkload(test::Workload::Light);
+
+    /* Restore swap throttling however the test exits */
+    eglSwapInterval(util::ctx.dpy, 0);
+    test::scoped<EGLint> swapInterval(1, boost::bind(eglSwapInterval, util::ctx.dpy, _1));
+
+    int64_t start = util::getTime();
+    int64_t startCPU = util::getCPUTime();
+    for (int frame = 0; frame < frames + framesInFlight; frame++)
+    {
+        int slot = frame % framesInFlight;
+
+        /* Throttle on the oldest frame in flight */
+        if (fences[slot] != EGL_NO_SYNC_KHR)
+        {
+            if (!completed[slot])
+            {
+                EGLint ret = eglClientWaitSyncKHR(util::ctx.dpy, fences[slot],
+                        0, 1000ull * 1000 * 1000);
+                latency.add(util::getTime() - submitTimes[slot]);
+                if (ret != EGL_CONDITION_SATISFIED_KHR)
+                {
+                    destroyFrameFences(fences);
+                    test::fail("Waiting for frame %d failed: 0x%x\n", frame - framesInFlight, ret);
+                }
+            }
+            eglDestroySyncKHR(util::ctx.dpy, fences[slot]);
+            fences[slot] = EGL_NO_SYNC_KHR;
+        }
+
+        /* The last iterations only drain the frames still in flight */
+        if (frame >= frames)
+        {
+            continue;
+        }
+
+        renderWorkload(frame);
+        fences[slot] = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_FENCE_KHR, NULL);
+        if (fences[slot] == EGL_NO_SYNC_KHR)
+        {
+            destroyFrameFences(fences);
+            test::fail("Creating the fence of frame %d failed\n", frame);
+        }
+        test::swapBuffers();
+        submitTimes[slot] = util::getTime();
+        completed[slot] = false;
+
+        pollFrameFences(fences, submitTimes, completed, latency);
+    }
+    int64_t time = util::getTime() - start;
+    int64_t cpuTime = util::getCPUTime() - startCPU;
+
+    ASSERT_GL();
+    ASSERT_EGL();
+
+    printf("%.2fx overdraw, %.1f frames/s, %lld us CPU/frame, %lld us latency, %lld us 99%% : ",
+            workload->overdraw(),
+            frames / (time / 1e9),
+            (long long)(cpuTime / frames / 1000),
+            (long long)(latency.mean() / 1000),
+            (long long)(latency.percentile(99) / 1000));
+}
+
+/** Ways of waiting for a fence */
+enum WaitStrategy
+{
+    WaitBlocking,       /** A single wait without a timeout */
+    WaitPolling,        /** Zero timeout waits with sleeps in between */
+    WaitTimeout         /** Repeated waits with a short timeout */
+};
+
+/** Average wait time of the spinning poll loop, used as the reference */
+static int64_t spinWaitTime = 0;
+
+/**
+ *  Measure the cost and responsiveness of a fence wait strategy.
+ *
+ *  Test loop:
+ *
+ *  1. Render a frame of the workload at the light load level, place a fence
+ *     after it and flush.
+ *  2. Wait for the fence using @strategy:
+ *     - WaitBlocking: call eglClientWaitSyncKHR with EGL_FOREVER_KHR.
+ *     - WaitPolling: call eglClientWaitSyncKHR with a zero timeout and sleep
+ *       for @interval nanoseconds until the fence is signaled. An interval
+ *       of zero spins without sleeping.
+ *     - WaitTimeout: call eglClientWaitSyncKHR with a timeout of @interval
+ *       nanoseconds until the fence is signaled.
+ *  3. Measure the wall time and thread CPU time spent waiting.
+ *
+ *  The spinning poll loop notices the fence being signaled soonest, so it is
+ *  run first and its average wait time serves as the reference for the wakeup
+ *  latency of the other strategies.
+ *
+ *  The test results are the average wait time, the wakeup latency relative
+ *  to spinning, the share of the wait spent on the CPU, the number of
+ *  eglClientWaitSyncKHR calls per wait and, for short timeouts, how much
+ *  expired waits overshot the timeout. A blocking wait that keeps the CPU
+ *  busy for most of a wait longer than 100 us is reported as busy-waiting.
+ */
+void testWaitStrategy(WaitStrategy strategy, int64_t interval)
+{
+    const int frames = 32;
+    util::Samples waitTime, overshoot;
+    int64_t totalCPU = 0;
+    int calls = 0;
+
+    calibrateWorkload(test::Workload::Light);
+
+    for (int frame = 0; frame < frames; frame++)
+    {
+        renderWorkload(frame);
+        EGLSyncKHR sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_FENCE_KHR, NULL);
+        ASSERT(sync != EGL_NO_SYNC_KHR);
+        glFlush();
+
+        int64_t start = util::getTime();
+        int64_t startCPU = util::getThreadCPUTime();
+        EGLint ret;
+
+        if (strategy == WaitBlocking)
+        {
+            ret = eglClientWaitSyncKHR(util::ctx.dpy, sync, 0, EGL_FOREVER_KHR);
+            calls++;
+        }
+        else
+        {
+            EGLTimeKHR timeout = (strategy == WaitTimeout) ? interval : 0;
+
+            while (true)
+            {
+                int64_t callStart = util::getTime();
+                ret = eglClientWaitSyncKHR(util::ctx.dpy, sync, 0, timeout);
+                calls++;
+
+                if (ret != EGL_TIMEOUT_EXPIRED_KHR)
+                {
+                    break;
+                }
+                if (strategy == WaitTimeout)
+                {
+                    overshoot.add(util::getTime() - callStart - interval);
+                }
+                else if (interval)
+                {
+                    usleep(interval / 1000);
+                }
+            }
+        }
+        totalCPU += util::getThreadCPUTime() - startCPU;
+        waitTime.add(util::getTime() - start);
+
+        eglDestroySyncKHR(util::ctx.dpy, sync);
+        ASSERT(ret == EGL_CONDITION_SATISFIED_KHR);
+        test::swapBuffers();
+    }
+    ASSERT_GL();
+    ASSERT_EGL();
+
+    int64_t totalWait = waitTime.mean() * frames;
+    double cpuShare = totalWait ? 100.0 * totalCPU / totalWait : 0.0;
+
+    if (strategy == WaitPolling && !interval)
+    {
+        spinWaitTime = waitTime.mean();
+    }
+
+    printf("%lld us wait, %lld us wakeup, %.0f%% CPU, %.1f calls/wait",
+            (long long)(waitTime.mean() / 1000),
+            (long long)(std::max(waitTime.mean() - spinWaitTime, (int64_t)0) / 1000),
+            cpuShare,
+            float(calls) / frames);
+    if (overshoot.count())
+    {
+        printf(", %lld us overshoot, %lld us worst",
+                (long long)(overshoot.mean() / 1000),
+                (long long)(overshoot.max() / 1000));
+    }
+    /* Very short waits are dominated by call overhead and say nothing about
+     * how the driver waits */
+    if (strategy == WaitBlocking && waitTime.mean() > 100 * 1000 && cpuShare > 50)
+    {
+        printf(", busy-waits");
+    }
+    printf(" : ");
+}
+
+/**
+ * Verify that the server wait extension is present
+ */
+void testWaitSyncPresence()
+{
+    ASSERT(util::isEGLExtensionSupported("EGL_KHR_wait_sync"));
+
+    eglWaitSyncKHR =
+        (PFNEGLWAITSYNCKHRPROC)eglGetProcAddress("eglWaitSyncKHR");
+
+    ASSERT(eglWaitSyncKHR);
+}
+
+/**
+ *  Test server-side waits in a single context.
+ *
+ *  1. Render and place a fence.
+ *  2. Check that a server wait with nonzero flags is rejected.
+ *  3. Make the context wait for the fence and destroy the fence right away.
+ *  4. Render more and check that both renderings are visible.
+ */
+void testServerWait()
+{
+    const uint8_t blue[] = {0x00, 0x00, 0xff, 0xff};
+    const uint8_t yellow[] = {0xff, 0xff, 0x00, 0xff};
+
+    glClearColor(0.0, 0.0, 1.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    EGLSyncKHR sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_FENCE_KHR, NULL);
+    ASSERT_EGL();
+
+    ASSERT(!eglWaitSyncKHR(util::ctx.dpy, sync, EGL_SYNC_FLUSH_COMMANDS_BIT_KHR));
+    ASSERT(eglGetError() == EGL_BAD_PARAMETER);
+
+    ASSERT(eglWaitSyncKHR(util::ctx.dpy, sync, 0) == EGL_TRUE);
+    eglDestroySyncKHR(util::ctx.dpy, sync);
+    ASSERT_EGL();
+
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, 8, 8);
+    glClearColor(1.0, 1.0, 0.0, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+
+    ASSERT(test::checkColor(4, 4, yellow));
+    ASSERT(test::checkColor(12, 12, blue));
+    ASSERT_GL();
+    test::swapBuffers();
+}
+
+/** Producer and consumer state for the cross-context wait benchmark */
+struct WaitSyncPipeline
+{
+    pthread_mutex_t lock;
+    pthread_cond_t changed;             /** Signaled when a frame is produced or consumed */
+    EGLContext context;                 /** Producer context sharing the textures */
+    EGLSurface surface;                 /** Dummy producer surface */
+    GLuint textures[2];                 /** Shared textures the producer renders into */
+    EGLSyncKHR produced[2];             /** Fence after the content of each texture */
+    EGLSyncKHR consumed[2];             /** Fence after the last draw from each texture */
+    int producedFrames;
+    int consumedFrames;
+    int frames;                         /** Number of frames to produce */
+    int width;
+    int height;
+    bool serverWait;                    /** Use eglWaitSyncKHR instead of client waits */
+    bool producerReady;                 /** Set when the producer has calibrated */
+    bool failed;                        /** Set when the producer failed and stopped */
+    int64_t producerStall;              /** Time the producer spent in waits */
+};
+
+/**
+ *  Wait for a fence placed in another context and destroy it. Returns the
+ *  time the calling thread spent waiting.
+ */
+static int64_t waitForContext(EGLSyncKHR sync, bool serverWait)
+{
+    int64_t start = util::getTime();
+
+    if (serverWait)
+    {
+        eglWaitSyncKHR(util::ctx.dpy, sync, 0);
+    }
+    else
+    {
+        eglClientWaitSyncKHR(util::ctx.dpy, sync, 0, EGL_FOREVER_KHR);
+    }
+    int64_t time = util::getTime() - start;
+
+    eglDestroySyncKHR(util::ctx.dpy, sync);
+    return time;
+}
+
+/**
+ *  Producer thread for the cross-context wait benchmark
+ */
+void* waitSyncProducerThread(void* data)
+{
+    WaitSyncPipeline* pipeline = reinterpret_cast<WaitSyncPipeline*>(data);
+    GLuint framebuffers[2] = {0, 0};
+    GLint program = 0;
+
+    /* Failures are recorded for the main thread, which checks them after
+     * joining this thread */
+    try
+    {
+        ASSERT(eglMakeCurrent(util::ctx.dpy, pipeline->surface, pipeline->surface,
+                              pipeline->context));
+        program = util::createProgram(test::color::vertSource, test::color::fragSource);
+        test::useProgram(program);
+        test::setViewport(0, 0, pipeline->width, pipeline->height);
+
+        glGenFramebuffers(2, framebuffers);
+        for (int i = 0; i < 2; i++)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[i]);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                                   pipeline->textures[i], 0);
+            ASSERT(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+        }
+
+        /* Calibrate the producer's own workload and let the consumer start */
+        test::Workload content;
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[0]);
+        content.calibrate(test::Workload::Light, pipeline->width, pipeline->height);
+
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->producerReady = true;
+        pthread_cond_signal(&pipeline->changed);
+        pthread_mutex_unlock(&pipeline->lock);
+
+        for (int frame = 0; frame < pipeline->frames; frame++)
+        {
+            int slot = frame % 2;
+
+            /* Wait until the consumer has drawn from this texture */
+            pthread_mutex_lock(&pipeline->lock);
+            while (frame >= pipeline->consumedFrames + 2)
+            {
+                pthread_cond_wait(&pipeline->changed, &pipeline->lock);
+            }
+            EGLSyncKHR consumed = pipeline->consumed[slot];
+            pipeline->consumed[slot] = EGL_NO_SYNC_KHR;
+            pthread_mutex_unlock(&pipeline->lock);
+
+            /* Make sure the consumer's draw has completed before overwriting */
+            if (consumed != EGL_NO_SYNC_KHR)
+            {
+                pipeline->producerStall += waitForContext(consumed, pipeline->serverWait);
+            }
+
+            /* Render the content and the fence marking its completion */
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[slot]);
+            content.render(frame);
+            test::color::drawQuad(0, 0, pipeline->width, pipeline->height,
+                                  0.0f, (frame & 0x1) ? 1.0f : 0.0f,
+                                  (frame & 0x1) ? 0.0f : 1.0f);
+            EGLSyncKHR produced = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_FENCE_KHR, NULL);
+            ASSERT(produced != EGL_NO_SYNC_KHR);
+            glFlush();
+
+            pthread_mutex_lock(&pipeline->lock);
+            pipeline->produced[slot] = produced;
+            pipeline->producedFrames = frame + 1;
+            pthread_cond_signal(&pipeline->changed);
+            pthread_mutex_unlock(&pipeline->lock);
+        }
+        ASSERT_GL();
+        ASSERT_EGL();
+    }
+    catch (const std::runtime_error& e)
+    {
+        printf("Producer failed: %s", e.what());
+
+        pthread_mutex_lock(&pipeline->lock);
+        pipeline->failed = true;
+        pthread_cond_signal(&pipeline->changed);
+        pthread_mutex_unlock(&pipeline->lock);
+    }
+
+    if (eglGetCurrentContext() == pipeline->context)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(2, framebuffers);
+        if (program)
+        {
+            util::destroyProgram(program);
+        }
+        test::resetRenderState();
+        glFinish();
+
+        eglMakeCurrent(util::ctx.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+    return NULL;
+}
+
+/**
+ *  Measure how much CPU stall server-side waits remove from a producer and
+ *  consumer which render in separate contexts.
+ *
+ *  Initialization:
+ *
+ *  1. Create two textures and a producer context sharing them.
+ *  2. Start a producer thread rendering into the textures through
+ *     framebuffer objects and calibrate its workload.
+ *
+ *  Test loop:
+ *
+ *  1. In the producer thread, wait for the fence after the consumer's last
+ *     draw from the next texture.
+ *  2. Render a light workload and a solid color into the texture, place a
+ *     fence and flush.
+ *  3. In the main thread, wait for the fence of the produced frame.
+ *  4. Draw the texture into the window, place a fence, flush and swap.
+ *
+ *  Waits use eglWaitSyncKHR if @serverWait is set and eglClientWaitSyncKHR
+ *  otherwise. The window contents of the last frame are checked.
+ *
+ *  The test results are the number of frames per second, the average time
+ *  per frame the consumer and the producer were blocked in waits and the
+ *  consumer thread CPU time per frame.
+ */
+void testCrossContextWait(bool serverWait)
+{
+    const int frames = 64;
+    WaitSyncPipeline pipeline;
+    EGLConfig config;
+    EGLint configCount;
+    int64_t consumerStall = 0;
+
+    const EGLint configAttrs[] =
+    {
+        EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE
+    };
+
+    const EGLint contextAttrs[] =
+    {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+
+    const EGLint surfaceAttrs[] =
+    {
+        EGL_WIDTH,  1,
+        EGL_HEIGHT, 1,
+        EGL_NONE
+    };
+
+    eglQuerySurface(util::ctx.dpy, util::ctx.surface, EGL_WIDTH, &pipeline.width);
+    eglQuerySurface(util::ctx.dpy, util::ctx.surface, EGL_HEIGHT, &pipeline.height);
+
+    /* Create the shared textures and the producer context */
+    glGenTextures(2, pipeline.textures);
+    for (int i = 0; i < 2; i++)
+    {
+        glBindTexture(GL_TEXTURE_2D, pipeline.textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pipeline.width, pipeline.height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        pipeline.produced[i] = EGL_NO_SYNC_KHR;
+        pipeline.consumed[i] = EGL_NO_SYNC_KHR;
+    }
+    ASSERT_GL();
+
+    eglChooseConfig(util::ctx.dpy, configAttrs, &config, 1, &configCount);
+    ASSERT_EGL();
+    ASSERT(configCount == 1);
+
+    pipeline.context = eglCreateContext(util::ctx.dpy, config, util::ctx.context, contextAttrs);
+    ASSERT_EGL();
+    pipeline.surface = eglCreatePbufferSurface(util::ctx.dpy, config, surfaceAttrs);
+    ASSERT_EGL();
+
+    pthread_mutex_init(&pipeline.lock, NULL);
+    pthread_cond_init(&pipeline.changed, NULL);
+    pipeline.producedFrames = 0;
+    pipeline.consumedFrames = 0;
+    pipeline.frames = frames;
+    pipeline.serverWait = serverWait;
+    pipeline.producerReady = false;
+    pipeline.failed = false;
+    pipeline.producerStall = 0;
+
+    /* Make sure the textures exist before the producer renders into them */
+    glFinish();
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, waitSyncProducerThread, &pipeline);
+
+    pthread_mutex_lock(&pipeline.lock);
+    while (!pipeline.producerReady && !pipeline.failed)
+    {
+        pthread_cond_wait(&pipeline.changed, &pipeline.lock);
+    }
+    pthread_mutex_unlock(&pipeline.lock);
+
+    int64_t start = util::getTime();
+    int64_t startCPU = util::getThreadCPUTime();
+    bool colorOk = true;
+    for (int frame = 0; frame < frames; frame++)
+    {
+        int slot = frame % 2;
+
+        pthread_mutex_lock(&pipeline.lock);
+        while (pipeline.producedFrames <= frame && !pipeline.failed)
+        {
+            pthread_cond_wait(&pipeline.changed, &pipeline.lock);
+        }
+        if (pipeline.producedFrames <= frame)
+        {
+            pthread_mutex_unlock(&pipeline.lock);
+            break;
+        }
+        EGLSyncKHR produced = pipeline.produced[slot];
+        pipeline.produced[slot] = EGL_NO_SYNC_KHR;
+        pthread_mutex_unlock(&pipeline.lock);
+
+        consumerStall += waitForContext(produced, serverWait);
+
+        glBindTexture(GL_TEXTURE_2D, pipeline.textures[slot]);
+        test::drawQuad(0, 0, pipeline.width, pipeline.height);
+        EGLSyncKHR consumed = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_FENCE_KHR, NULL);
+        glFlush();
+
+        pthread_mutex_lock(&pipeline.lock);
+        pipeline.consumed[slot] = consumed;
+        pipeline.consumedFrames = frame + 1;
+        pthread_cond_signal(&pipeline.changed);
+        pthread_mutex_unlock(&pipeline.lock);
+
+        if (frame == frames - 1)
+        {
+            uint8_t green = (frame & 0x1) ? 0xff : 0x00;
+            const uint8_t color[] = {0x00, green, (uint8_t)(0xff - green), 0xff};
+            colorOk = test::checkColor(pipeline.width / 2, pipeline.height / 2, color);
+        }
+        test::swapBuffers();
+    }
+    int64_t time = util::getTime() - start;
+    int64_t cpuTime = util::getThreadCPUTime() - startCPU;
+
+    pthread_join(thread, NULL);
+
+    for (int i = 0; i < 2; i++)
+    {
+        if (pipeline.produced[i] != EGL_NO_SYNC_KHR)
+        {
+            eglDestroySyncKHR(util::ctx.dpy, pipeline.produced[i]);
+        }
+        if (pipeline.consumed[i] != EGL_NO_SYNC_KHR)
+        {
+            eglDestroySyncKHR(util::ctx.dpy, pipeline.consumed[i]);
+        }
+    }
+    eglDestroySurface(util::ctx.dpy, pipeline.surface);
+    util::forgetPrograms(pipeline.context);
+    eglDestroyContext(util::ctx.dpy, pipeline.context);
+    glDeleteTextures(2, pipeline.textures);
+    pthread_cond_destroy(&pipeline.changed);
+    pthread_mutex_destroy(&pipeline.lock);
+    ASSERT_GL();
+    ASSERT_EGL();
+    ASSERT(!pipeline.failed);
+    ASSERT(colorOk);
+
+    printf("%.1f frames/s, %lld us consumer stall, %lld us producer stall, "
+           "%lld us CPU/frame : ",
+            frames / (time / 1e9),
+            (long long)(consumerStall / frames / 1000),
+            (long long)(pipeline.producerStall / frames / 1000),
+            (long long)(cpuTime / frames / 1000));
+}
+
+/** Ways of waiting for rendering to complete */
+enum CompletionPrimitive
+{
+    CompleteFence,      /** eglClientWaitSyncKHR on a fence */
+    CompleteFinish,     /** glFinish() */
+    CompleteReadback,   /** A 1x1 glReadPixels() */
+    CompleteWaitClient  /** eglWaitClient() */
+};
+
+/**
+ *  Compare the cost of waiting for rendering to complete with different
+ *  primitives.
+ *
+ *  Test loop:
+ *
+ *  1. Render a frame of the workload at the light load level.
+ *  2. Wait for the rendering to complete with @primitive.
+ *  3. Swap buffers.
+ *
+ *  The test results are the average and 99th percentile time spent waiting
+ *  and the thread CPU time per wait.
+ */
+void testCompletionPrimitive(CompletionPrimitive primitive)
+{
+    const int frames = 32;
+    util::Samples waitTime;
+    int64_t totalCPU = 0;
+
+    calibrateWorkload(test::Workload::Light);
+
+    for (int frame = 0; frame < frames; frame++)
+    {
+        renderWorkload(frame);
+
+        int64_t start = util::getTime();
+        int64_t startCPU = util::getThreadCPUTime();
+        switch (primitive)
+        {
+        case CompleteFence:
+            {
+                EGLSyncKHR sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_FENCE_KHR, NULL);
+                ASSERT(sync != EGL_NO_SYNC_KHR);
+                EGLint ret = eglClientWaitSyncKHR(util::ctx.dpy, sync,
+                                                  EGL_SYNC_FLUSH_COMMANDS_BIT_KHR,
+                                                  EGL_FOREVER_KHR);
+                eglDestroySyncKHR(util::ctx.dpy, sync);
+                ASSERT(ret == EGL_CONDITION_SATISFIED_KHR);
+            }
+            break;
+        case CompleteFinish:
+            glFinish();
+            break;
+        case CompleteReadback:
+            {
+                GLubyte color[4];
+                glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, color);
+            }
+            break;
+        case CompleteWaitClient:
+            eglWaitClient();
+            break;
+        }
+        totalCPU += util::getThreadCPUTime() - startCPU;
+        waitTime.add(util::getTime() - start);
+
+        test::swapBuffers();
+    }
+    ASSERT_GL();
+    ASSERT_EGL();
+
+    printf("%lld us wait, %lld us 99%%, %lld us CPU : ",
+            (long long)(waitTime.mean() / 1000),
+            (long long)(waitTime.percentile(99) / 1000),
+            (long long)(totalCPU / frames / 1000));
+}
+
 int main(int argc, char** argv)
 {
     bool result;
@@ -399,6 +1385,14 @@ int main(int argc, char** argv)
     int winHeight = 480;
     int winDepth = 16;
 
+    const char* eglExtensions[] = {"EGL_KHR_fence_sync", NULL};
+    const char* glExtensions[] = {"GL_OES_EGL_sync", NULL};
+
+    if (test::skipUnsupported(eglExtensions, glExtensions))
+    {
+        return 1;
+    }
+
     EGLNativeDisplayType dpy;
     nativeCreateDisplay(&dpy);
     nativeGetDisplayProperties(dpy, &winWidth, &winHeight, &winDepth);
@@ -418,14 +1412,20 @@ int main(int argc, char** argv)
         EGL_NONE
     };
 
+    const int outstandingCounts[] = {1, 10, 100, 1000, 10000};
+    const int pollIntervals[] = {100, 1000};
+    const int waitTimeouts[] = {10, 100, 1000, 10000};
+
     result = util::createWindow(winWidth, winHeight, configAttrs, contextAttrs);
     ASSERT(result);
     ASSERT_EGL();
 
     GLint program = util::createProgram(test::vertSource, test::fragSource);
-    glUseProgram(program);
+    test::useProgram(program);
     ASSERT_GL();
 
+    workload = new test::Workload();
+
     test::printHeader("Testing extension presence");
     result &= test::verifyResult(testExtensionPresence);
 
@@ -448,11 +1448,81 @@ int main(int argc, char** argv)
     result &= test::verifyResult(boost::bind(testSyncQueue, false, false));
     test::printHeader("Testing sync queue out-of-order w/swaps");
     result &= test::verifyResult(boost::bind(testSyncQueue, false, true));
-    test::printHeader("Testing sync latency");
-    result &= test::verifyResult(testLatency);
+    for (int level = test::Workload::Idle; level <= test::Workload::Saturated; level++)
+    {
+        test::Workload::Level load = (test::Workload::Level)level;
+        test::printHeader("Testing sync latency at %s load", test::Workload::levelName(load));
+        result &= test::verifyResult(boost::bind(testLatency, load));
+    }
+
+    test::printHeader("Testing server wait extension presence");
+    if (test::verifyResult(testWaitSyncPresence))
+    {
+        test::printHeader("Testing server wait");
+        result &= test::verifyResult(testServerWait);
+        test::printHeader("Testing cross-context client wait");
+        result &= test::verifyResult(boost::bind(testCrossContextWait, false));
+        test::printHeader("Testing cross-context server wait");
+        result &= test::verifyResult(boost::bind(testCrossContextWait, true));
+    }
+
+    test::printHeader("Testing completion w/fence");
+    result &= test::verifyResult(boost::bind(testCompletionPrimitive, CompleteFence));
+    test::printHeader("Testing completion w/glFinish");
+    result &= test::verifyResult(boost::bind(testCompletionPrimitive, CompleteFinish));
+    test::printHeader("Testing completion w/1x1 readback");
+    result &= test::verifyResult(boost::bind(testCompletionPrimitive, CompleteReadback));
+    test::printHeader("Testing completion w/eglWaitClient");
+    result &= test::verifyResult(boost::bind(testCompletionPrimitive, CompleteWaitClient));
+
+    test::printHeader("Testing spinning wait");
+    result &= test::verifyResult(boost::bind(testWaitStrategy, WaitPolling, 0));
+    test::printHeader("Testing blocking wait");
+    result &= test::verifyResult(boost::bind(testWaitStrategy, WaitBlocking, 0));
+
+    for (unsigned int i = 0; i < sizeof(pollIntervals) / sizeof(pollIntervals[0]); i++)
+    {
+        test::printHeader("Testing polling wait every %d us", pollIntervals[i]);
+        result &= test::verifyResult(boost::bind(testWaitStrategy, WaitPolling,
+                                                 pollIntervals[i] * 1000LL));
+    }
+
+    for (unsigned int i = 0; i < sizeof(waitTimeouts) / sizeof(waitTimeouts[0]); i++)
+    {
+        test::printHeader("Testing wait with %d us timeout", waitTimeouts[i]);
+        result &= test::verifyResult(boost::bind(testWaitStrategy, WaitTimeout,
+                                                 waitTimeouts[i] * 1000LL));
+    }
+
+    for (int framesInFlight = 1; framesInFlight <= 3; framesInFlight++)
+    {
+        test::printHeader("Testing frame pacing with %d frames in flight", framesInFlight);
+        result &= test::verifyResult(boost::bind(testFramePacing, framesInFlight));
+    }
+
+    for (int depth = 1; depth <= 8; depth++)
+    {
+        test::printHeader("Testing cross-thread sync pipeline (depth %d)", depth);
+        result &= test::verifyResult(boost::bind(testSyncPipeline, depth));
+    }
+
+    for (unsigned int i = 0; i < sizeof(outstandingCounts) / sizeof(outstandingCounts[0]); i++)
+    {
+        int count = outstandingCounts[i];
+
+        test::printHeader("Testing %d outstanding syncs in-order", count);
+        result &= test::verifyResult(boost::bind(testSyncThroughput, count, true, false));
+        test::printHeader("Testing %d outstanding syncs in-order w/swaps", count);
+        result &= test::verifyResult(boost::bind(testSyncThroughput, count, true, true));
+        test::printHeader("Testing %d outstanding syncs out-of-order", count);
+        result &= test::verifyResult(boost::bind(testSyncThroughput, count, false, false));
+        test::printHeader("Testing %d outstanding syncs out-of-order w/swaps", count);
+        result &= test::verifyResult(boost::bind(testSyncThroughput, count, false, true));
+    }
 
 out:
-    glDeleteProgram(program);
+    delete workload;
+    util::destroyProgram(program);
     util::destroyWindow();
 
     printf("================================================\n");
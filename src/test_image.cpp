@@ -23,10 +23,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <malloc.h>
+#include <unistd.h>
 
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 
+#include <algorithm>
+
 #include <boost/scoped_array.hpp>
 
 #include "ext.h"
@@ -508,60 +511,153 @@ void testUseAfterDestroy(int width, int height, int depth)
 }
 
 /**
- *  Measure how long it takes to bind an EGLImage to a texture.
+ *  Source buffer types an EGLImage can be created from.
+ */
+enum ImageSource
+{
+    SourcePixmap,
+    SourceTexture,
+    SourceRenderbuffer
+};
+
+static const char* imageSourceName(ImageSource source)
+{
+    switch (source)
+    {
+        case SourcePixmap:
+            return "pixmap";
+        case SourceTexture:
+            return "texture";
+        case SourceRenderbuffer:
+            return "renderbuffer";
+    }
+    return "unknown";
+}
+
+/**
+ *  Check whether EGLImages of the given source type and depth can be created.
+ */
+static bool isImageSourceSupported(ImageSource source, int depth)
+{
+    switch (source)
+    {
+        case SourcePixmap:
+            return true;
+        case SourceTexture:
+            return util::isEGLExtensionSupported("EGL_KHR_gl_texture_2D_image");
+        case SourceRenderbuffer:
+            if (!util::isEGLExtensionSupported("EGL_KHR_gl_renderbuffer_image"))
+            {
+                return false;
+            }
+            /* Only 16bpp color renderbuffers are core in GLES2 */
+            return depth == 16 || util::isGLExtensionSupported("GL_OES_rgb8_rgba8");
+    }
+    return false;
+}
+
+/**
+ *  Measure how long it takes to create an EGLImage and bind it to a texture.
  *
  *  Initialization:
  *
- *  1. Create @width x @height pixmap.
+ *  1. Create a @width x @height source buffer of the given @depth: a native
+ *     pixmap, a GL texture or a GL renderbuffer depending on @source.
  *  2. Create a texture object.
  *
  *  Test loop:
  *
- *  1. Create an EGLImage from the pixmap using EGL_NATIVE_PIXMAP_KHR.
+ *  1. Create an EGLImage from the source buffer, with EGL_IMAGE_PRESERVED_KHR
+ *     set to @preserved.
  *  2. Bind the EGLImage to the texture.
  *  3. Draw a 1x1 quad using the texture and read a pixel to force rendering to
  *     complete.
  *
  *  The test result is the average time for each step in the test loop.
  */
-void testMappingLatency(int width, int height)
+void testMappingLatency(ImageSource source, int width, int height, int depth,
+                        bool preserved)
 {
     test::scoped<Pixmap> pixmap(
             boost::bind(nativeDestroyPixmap, util::ctx.nativeDisplay, _1));
     EGLImageKHR image;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLenum target = EGL_NATIVE_PIXMAP_KHR;
+    EGLClientBuffer buffer;
+    GLuint sourceTexture = 0, sourceRenderbuffer = 0;
     GLuint targetTexture;
 
-    int cycles = 64;
+    int cycles = 32;
     int64_t start, totalImageCreation = 0,
             totalImageBinding = 0, totalRendering = 0;
     uint8_t color[4];
 
     const EGLint imageAttributes[] =
     {
-        EGL_IMAGE_PRESERVED_KHR, EGL_TRUE,
+        EGL_IMAGE_PRESERVED_KHR, preserved ? EGL_TRUE : EGL_FALSE,
         EGL_NONE
     };
 
-    /* Create the pixmap */
-    ASSERT(nativeCreatePixmap(util::ctx.nativeDisplay, 32, width, height, &pixmap));
-    fillPixmap(pixmap, width, height, 32);
+    /* Create the source buffer */
+    switch (source)
+    {
+        case SourcePixmap:
+        {
+            ASSERT(nativeCreatePixmap(util::ctx.nativeDisplay, depth, width, height, &pixmap));
+            fillPixmap(pixmap, width, height, depth);
+            buffer = (EGLClientBuffer)(intptr_t)pixmap;
+            break;
+        }
+        case SourceTexture:
+        {
+            GLenum format = (depth == 32) ? GL_RGBA : GL_RGB;
+            GLenum type = (depth == 16) ? GL_UNSIGNED_SHORT_5_6_5 : GL_UNSIGNED_BYTE;
+            boost::scoped_array<uint8_t> pixels(new uint8_t[width * height * 4]);
+
+            memset(&pixels[0], 0x80, width * height * 4);
+            glGenTextures(1, &sourceTexture);
+            glBindTexture(GL_TEXTURE_2D, sourceTexture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, type, &pixels[0]);
+            context = util::ctx.context;
+            target = EGL_GL_TEXTURE_2D_KHR;
+            buffer = (EGLClientBuffer)(intptr_t)sourceTexture;
+            break;
+        }
+        case SourceRenderbuffer:
+        {
+            GLenum format = (depth == 16) ? GL_RGB565 :
+                            (depth == 24) ? GL_RGB8_OES : GL_RGBA8_OES;
+
+            glGenRenderbuffers(1, &sourceRenderbuffer);
+            glBindRenderbuffer(GL_RENDERBUFFER, sourceRenderbuffer);
+            glRenderbufferStorage(GL_RENDERBUFFER, format, width, height);
+            context = util::ctx.context;
+            target = EGL_GL_RENDERBUFFER_KHR;
+            buffer = (EGLClientBuffer)(intptr_t)sourceRenderbuffer;
+            break;
+        }
+    }
+    ASSERT_GL();
 
     /* Measure creation and binding times */
     glGenTextures(1, &targetTexture);
     glBindTexture(GL_TEXTURE_2D, targetTexture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
     for (int i = 0; i < cycles; i++)
     {
-        /* Bind the pixmap to an image */
+        /* Bind the source buffer to an image */
         start = util::getTime();
-        image = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT,
-                                  EGL_NATIVE_PIXMAP_KHR,
-                                  (EGLClientBuffer)(intptr_t)pixmap,
+        image = eglCreateImageKHR(util::ctx.dpy, context, target, buffer,
                                   imageAttributes);
         totalImageCreation += util::getTime() - start;
+        ASSERT(image);
 
         /* Bind the image to a texture */
         start = util::getTime();
@@ -591,290 +687,1402 @@ void testMappingLatency(int width, int height)
             totalRendering / cycles / 1000UL);
 
     /* Clean up */
-    eglDestroyImageKHR(util::ctx.dpy, image);
     glDeleteTextures(1, &targetTexture);
+    if (sourceTexture)
+    {
+        glDeleteTextures(1, &sourceTexture);
+    }
+    if (sourceRenderbuffer)
+    {
+        glDeleteRenderbuffers(1, &sourceRenderbuffer);
+    }
 }
 
-struct SyncTestContext
+/**
+ *  Ways of making pixmap contents available to a texture each frame.
+ */
+enum ImageReuse
 {
-    test::scoped<Pixmap> pixmap;
-    pthread_mutex_t lock;
-    pthread_cond_t message;
-    int width, height;
-    bool done;
-    bool needContent;
+    ReuseRecreate,  /* Create and destroy the EGLImage every frame */
+    ReuseRebind,    /* Keep the EGLImage, re-target it onto the texture */
+    ReuseBound      /* Keep the EGLImage bound to the texture */
 };
 
+static const char* imageReuseName(ImageReuse reuse)
+{
+    switch (reuse)
+    {
+        case ReuseRecreate:
+            return "recreate";
+        case ReuseRebind:
+            return "rebind";
+        case ReuseBound:
+            return "bound";
+    }
+    return "unknown";
+}
+
 /**
- *  Worker thread for the implicit synchronization test
+ *  Compare the per-frame cost of recreating, rebinding and reusing an EGLImage.
+ *
+ *  Initialization:
+ *
+ *  1. Create @width x @height pixmap.
+ *  2. Create a texture object. Unless @reuse is ReuseRecreate, create an
+ *     EGLImage from the pixmap. For ReuseBound, bind it to the texture.
+ *
+ *  Test loop:
+ *
+ *  1. Fill the pixmap with a new solid color with XFillRectangle() and wait
+ *     for it with eglWaitNative().
+ *  2. For ReuseRecreate, create an EGLImage from the pixmap and bind it to the
+ *     texture. For ReuseRebind, bind the existing EGLImage to the texture.
+ *  3. Draw a 1x1 quad using the texture and read a pixel to force rendering to
+ *     complete.
+ *  4. For ReuseRecreate, destroy the EGLImage and orphan the texture.
+ *  5. Check that the pixel has the new color, i.e., that the texture picked
+ *     up the pixmap update.
+ *
+ *  The test result is the average time per frame, excluding the pixmap
+ *  updates and buffer swaps.
  */
-void* contentProducerThread(void* data)
+void testImageReuseLatency(int width, int height, ImageReuse reuse)
 {
-    SyncTestContext* ctx = reinterpret_cast<SyncTestContext*>(data);
-    EGLConfig config;
-    EGLContext context;
-    EGLSurface dummySurface;
-    EGLint configCount;
+    test::scoped<Pixmap> pixmap(
+            boost::bind(nativeDestroyPixmap, util::ctx.nativeDisplay, _1));
+    EGLImageKHR image = EGL_NO_IMAGE_KHR;
+    GLuint targetTexture;
 
-    const EGLint configAttrs[] =
-    {
-        EGL_BUFFER_SIZE,     32,
-        EGL_SURFACE_TYPE,    EGL_PIXMAP_BIT,
-        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
-        EGL_NONE
-    };
+    int cycles = 64;
+    int64_t start, total = 0;
+    uint8_t color[4];
+    bool stale = false;
 
-    const EGLint contextAttrs[] =
+    const uint32_t colors[2] = {0xffff0000, 0xff0000ff};
+    const EGLint imageAttributes[] =
     {
-        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_IMAGE_PRESERVED_KHR, EGL_TRUE,
         EGL_NONE
     };
 
-    /* Create a dummy offscreen rendering surface */
-    test::scoped<Pixmap> dummyPixmap(
-            boost::bind(nativeDestroyPixmap, util::ctx.nativeDisplay, _1));
-
-    ASSERT(nativeCreatePixmap(
-            util::ctx.nativeDisplay, 32, 64, 64, &dummyPixmap));
-
-    eglChooseConfig(util::ctx.dpy, configAttrs, &config, 1, &configCount);
-    ASSERT_EGL();
-    ASSERT(configCount == 1);
-
-    context = eglCreateContext(util::ctx.dpy, config, EGL_NO_CONTEXT,
-                               contextAttrs);
-    ASSERT_EGL();
-
-    dummySurface = eglCreatePixmapSurface(util::ctx.dpy, config,
-                                          dummyPixmap, NULL);
-    ASSERT_EGL();
-
-    eglMakeCurrent(util::ctx.dpy, dummySurface, dummySurface, context);
-    ASSERT_EGL();
-
-    /* Create an EGLImage from the shared pixmap */
-    EGLImageKHR image;
-    image = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT, EGL_NATIVE_PIXMAP_KHR,
-                              (EGLClientBuffer)(intptr_t)ctx->pixmap, NULL);
-    ASSERT_EGL();
-
-    /* Bind the image to a renderbuffer */
-    GLuint renderbuffer;
-    glGenRenderbuffers(1, &renderbuffer);
-    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
-    glEGLImageTargetRenderbufferStorageOES(GL_RENDERBUFFER, image);
-    ASSERT_GL();
+    ASSERT(nativeCreatePixmap(util::ctx.nativeDisplay, 32, width, height, &pixmap));
+    fillPixmap(pixmap, width, height, 32);
+    GC gc = XCreateGC(util::ctx.nativeDisplay, pixmap, 0, NULL);
 
-    /* Bind the renderbuffer to a framebuffer */
-    GLuint framebuffer;
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                              GL_RENDERBUFFER, renderbuffer);
-    ASSERT_GL();
+    glGenTextures(1, &targetTexture);
+    glBindTexture(GL_TEXTURE_2D, targetTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 
-    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-    if (status != GL_FRAMEBUFFER_COMPLETE)
+    if (reuse != ReuseRecreate)
     {
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        image = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT,
+                                  EGL_NATIVE_PIXMAP_KHR,
+                                  (EGLClientBuffer)(intptr_t)pixmap,
+                                  imageAttributes);
+        ASSERT(image);
+    }
+    if (reuse == ReuseBound)
+    {
+        glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
     }
-    ASSERT(status == GL_FRAMEBUFFER_COMPLETE);
-
-    /* Prepare blitter program */
-    GLint program = util::createProgram(test::color::vertSource,
-                                        test::color::fragSource);
-    glUseProgram(program);
-    glViewport(0, 0, ctx->width, ctx->height);
 
-    int frame = 0;
-    while (1)
+    for (int i = 0; i < cycles; i++)
     {
-        /* Wait for a content request */
-        pthread_mutex_lock(&ctx->lock);
-        while (!ctx->needContent && !ctx->done)
-        {
-            pthread_cond_wait(&ctx->message, &ctx->lock);
-        }
-        pthread_mutex_unlock(&ctx->lock);
+        /* Update the pixmap like a client would */
+        XSetForeground(util::ctx.nativeDisplay, gc, colors[i % 2]);
+        XFillRectangle(util::ctx.nativeDisplay, pixmap, gc, 0, 0, width, height);
+        eglWaitNative(EGL_CORE_NATIVE_ENGINE);
 
-        if (ctx->done)
+        start = util::getTime();
+        switch (reuse)
         {
-            break;
+            case ReuseRecreate:
+                image = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT,
+                                          EGL_NATIVE_PIXMAP_KHR,
+                                          (EGLClientBuffer)(intptr_t)pixmap,
+                                          imageAttributes);
+                ASSERT(image);
+                glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+                break;
+            case ReuseRebind:
+                glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+                break;
+            case ReuseBound:
+                break;
         }
 
-        /* Clear the pixmap with red (i.e., invalid color) */
-        GLubyte color[4];
-        glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
+        test::drawQuad(0, 0, 1, 1);
         glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, color);
-        ASSERT_GL();
 
-        /* Fill the pixmap with non-red semi-complex rendering */
-        int tileSize = 16;
-        for (int y = 0; y < ctx->height + tileSize; y += tileSize)
+        if (reuse == ReuseRecreate)
         {
-            for (int x = 0; x < ctx->width + tileSize; x += tileSize)
-            {
-                bool green = frame & 0x1;
-                bool blue  = frame & 0x2;
-                test::color::drawQuad(x, y, tileSize, tileSize,
-                        0.0f,
-                        green ? float(y) / ctx->height : 0.0f,
-                        blue  ? float(x) / ctx->width  : 0.0f);
-            }
+            eglDestroyImageKHR(util::ctx.dpy, image);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, color);
+        }
+        total += util::getTime() - start;
+
+        uint8_t r = (colors[i % 2] >> 16) & 0xff;
+        uint8_t b = colors[i % 2] & 0xff;
+        if (abs(color[0] - r) > 8 || abs(color[2] - b) > 8)
+        {
+            stale = true;
+            break;
         }
 
-        /* Flush and signal the main thread */
-        glFlush();
-        ctx->needContent = false;
-        pthread_cond_signal(&ctx->message);
-        frame++;
+        test::swapBuffers();
+        ASSERT_GL();
+        ASSERT_EGL();
     }
 
-    glDeleteRenderbuffers(1, &renderbuffer);
-    glDeleteFramebuffers(1, &framebuffer);
+    /* Clean up */
+    XFreeGC(util::ctx.nativeDisplay, gc);
+    glDeleteTextures(1, &targetTexture);
+    if (reuse != ReuseRecreate)
+    {
+        eglDestroyImageKHR(util::ctx.dpy, image);
+    }
 
-    eglDestroyImageKHR(util::ctx.dpy, image);
-    eglDestroyContext(util::ctx.dpy, context);
-    eglDestroySurface(util::ctx.dpy, dummySurface);
-    ASSERT_EGL();
+    if (stale)
+    {
+        test::fail("Pixmap update not visible with %s, got %02x%02x%02x%02x\n",
+                   imageReuseName(reuse), color[0], color[1], color[2], color[3]);
+    }
+    printf("%lld us per frame : ", (long long)(total / cycles / 1000));
+}
 
-    return NULL;
+/**
+ *  X requests used to update pixmap contents.
+ */
+enum PixmapUpdate
+{
+    UpdatePutImage,
+    UpdateCopyArea
+};
+
+static const char* pixmapUpdateName(PixmapUpdate update)
+{
+    switch (update)
+    {
+        case UpdatePutImage:
+            return "XPutImage";
+        case UpdateCopyArea:
+            return "XCopyArea";
+    }
+    return "unknown";
 }
 
 /**
- *  Test implicit render synchronization with pixmap-backed EGLImages.
+ *  Fill a 32bpp client side image with a solid @color
+ */
+static void fillImage(XImage* img, int width, int height, uint32_t color)
+{
+    uint8_t* data = (uint8_t*)img->data;
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            ((uint32_t*)data)[x] = color;
+        }
+        data += img->bytes_per_line;
+    }
+}
+
+/**
+ *  Measure how long it takes for an X side pixmap update to become visible
+ *  through a pixmap-backed EGLImage texture.
  *
  *  Initialization:
  *
- *  1. Create a pixmap.
- *  2. Create an EGLImage from the pixmap.
- *  3. Spawn a thread and create render context on the pixmap by binding it to
- *     an FBO using an EGLImage.
+ *  1. Create @width x @height pixmap and an EGLImage from it, and bind the
+ *     image to a texture.
+ *  2. Prepare two solid color images. For @update UpdateCopyArea, upload them
+ *     into two source pixmaps.
  *
  *  Test loop:
  *
- *  1. In the thread, render a solid red color into the pixmap and do a read
- *     back to force rendering to complete.
- *  2. Still in the thread, render semi-complex geometry into the pixmap using
- *     other colors than red.
- *  3. Call glFlush() and send a signal to the main thread.
- *  4. In the main thread, bind the EGLImage into a texture and render it into
- *     the window surface.
- *  5. Check that no red pixels are visible in the window surface output.
+ *  1. Replace the pixmap contents with the other color using either
+ *     XPutImage or XCopyArea, followed by eglWaitNative().
+ *  2. Draw a 1x1 quad using the texture and read back the pixel until it shows
+ *     the new color.
+ *
+ *  The test result is the average and worst time from the update request to
+ *  the new color being read back.
  */
-void testImplicitSync(int width, int height)
+void testPixmapVisibilityLatency(int width, int height, PixmapUpdate update)
 {
-    boost::scoped_array<uint32_t> pixels(new uint32_t[width * height]);
+    Display* dpy = util::ctx.nativeDisplay;
+    test::scoped<Pixmap> pixmap(boost::bind(nativeDestroyPixmap, dpy, _1));
+    test::scoped<Pixmap> sources[2] =
+    {
+        test::scoped<Pixmap>(boost::bind(nativeDestroyPixmap, dpy, _1)),
+        test::scoped<Pixmap>(boost::bind(nativeDestroyPixmap, dpy, _1)),
+    };
+    XImage* images[2];
+    EGLImageKHR image;
+    GLuint texture;
 
-    SyncTestContext ctx;
-    ctx.pixmap = test::scoped<Pixmap>(
-            boost::bind(nativeDestroyPixmap, util::ctx.nativeDisplay, _1));
-    ctx.width = width;
-    ctx.height = height;
-    ctx.done = false;
-    ctx.needContent = false;
+    const uint32_t colors[2] = {0xffff0000, 0xff0000ff};
+    const int64_t timeout = 100 * 1000 * 1000;
+    const int cycles = 64;
+    int64_t latency = 0, worstLatency = 0;
+    uint8_t color[4];
 
-    ASSERT(nativeCreatePixmap(
-            util::ctx.nativeDisplay, 32, ctx.width, ctx.height, &ctx.pixmap));
+    ASSERT(nativeCreatePixmap(dpy, 32, width, height, &pixmap));
 
-    /* Create an EGLImage from the shared pixmap */
-    EGLImageKHR image;
-    image = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT, EGL_NATIVE_PIXMAP_KHR,
-                              (EGLClientBuffer)(intptr_t)ctx.pixmap, NULL);
+    GC gc = XCreateGC(dpy, pixmap, 0, NULL);
+    for (int i = 0; i < 2; i++)
+    {
+        images[i] = XGetImage(dpy, pixmap, 0, 0, width, height, -1, ZPixmap);
+        ASSERT(images[i]);
+        ASSERT(images[i]->data);
+        fillImage(images[i], width, height, colors[i]);
+
+        if (update == UpdateCopyArea)
+        {
+            ASSERT(nativeCreatePixmap(dpy, 32, width, height, &sources[i]));
+            XPutImage(dpy, sources[i], gc, images[i], 0, 0, 0, 0, width, height);
+        }
+    }
+
+    /* Start from the second color so that the first update changes it */
+    XPutImage(dpy, pixmap, gc, images[1], 0, 0, 0, 0, width, height);
+    eglWaitNative(EGL_CORE_NATIVE_ENGINE);
+
+    image = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT,
+                              EGL_NATIVE_PIXMAP_KHR,
+                              (EGLClientBuffer)(intptr_t)pixmap, NULL);
     ASSERT_EGL();
 
-    GLuint texture;
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     ASSERT_GL();
 
-    /* Start the producer */
-    pthread_mutex_init(&ctx.lock, NULL);
-    pthread_cond_init(&ctx.message, NULL);
-    pthread_t thread;
-    pthread_create(&thread, NULL, contentProducerThread, &ctx);
-
-    for (int frame = 0; frame < 32; frame++)
+    for (int i = 0; i < cycles; i++)
     {
-        /* Request content from the producer */
-        ctx.needContent = true;
-        pthread_cond_signal(&ctx.message);
+        int current = i % 2;
+        uint8_t r = (colors[current] >> 16) & 0xff;
+        uint8_t b = colors[current] & 0xff;
 
-        /* Wait for content */
-        pthread_mutex_lock(&ctx.lock);
+        int64_t start = util::getTime();
+        if (update == UpdatePutImage)
+        {
+            XPutImage(dpy, pixmap, gc, images[current], 0, 0, 0, 0, width, height);
+        }
+        else
+        {
+            XCopyArea(dpy, sources[current], pixmap, gc, 0, 0, width, height, 0, 0);
+        }
+        eglWaitNative(EGL_CORE_NATIVE_ENGINE);
+
+        /* Probe until the new color shows up */
+        while (1)
+        {
+            glClear(GL_COLOR_BUFFER_BIT);
+            test::drawQuad(0, 0, 1, 1);
+            glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, color);
+            ASSERT_GL();
+
+            if (abs(color[0] - r) <= 8 && abs(color[2] - b) <= 8)
+            {
+                break;
+            }
+            if (util::getTime() - start > timeout)
+            {
+                XFreeGC(dpy, gc);
+                XDestroyImage(images[0]);
+                XDestroyImage(images[1]);
+                test::fail("Pixmap update not visible after %lld ms, "
+                           "got %02x%02x%02x%02x\n", (long long)(timeout / 1000000),
+                           color[0], color[1], color[2], color[3]);
+            }
+        }
+        int64_t time = util::getTime() - start;
+        latency += time;
+        worstLatency = std::max(worstLatency, time);
+
+        test::swapBuffers();
+    }
+
+    printf("%lld us latency, %lld us worst : ",
+           (long long)(latency / cycles / 1000),
+           (long long)(worstLatency / 1000));
+
+    /* Clean up */
+    glDeleteTextures(1, &texture);
+    eglDestroyImageKHR(util::ctx.dpy, image);
+    XFreeGC(dpy, gc);
+    XDestroyImage(images[0]);
+    XDestroyImage(images[1]);
+}
+
+/**
+ *  Test pixmap recycling through the native pixmap pool.
+ *
+ *  1. Get a pixmap from the pool and release it.
+ *  2. Get a pixmap of the same size and depth and check that the first one is
+ *     reused.
+ *  3. Get a pixmap of a different size and check that it is not reused.
+ *  4. Lower the pool memory limit and check that the idle pixmaps exceeding it
+ *     are destroyed.
+ */
+void testPixmapPool()
+{
+    const int width = 64, height = 64, depth = 32;
+    const size_t size = width * height * 4;
+    EGLNativePixmapType pixmap1, pixmap2, pixmap3;
+    int idleCount;
+    size_t idleBytes;
+
+    nativeFlushPixmapPool(util::ctx.nativeDisplay);
+    nativeSetPixmapPoolLimit(util::ctx.nativeDisplay, 4 * size);
+
+    /* Recycle a pixmap */
+    ASSERT(nativeCreatePooledPixmap(util::ctx.nativeDisplay, depth, width, height, &pixmap1));
+    nativeReleasePooledPixmap(util::ctx.nativeDisplay, pixmap1);
+    nativeGetPixmapPoolUsage(util::ctx.nativeDisplay, &idleCount, &idleBytes);
+    ASSERT(idleCount == 1);
+    ASSERT(idleBytes == size);
+
+    ASSERT(nativeCreatePooledPixmap(util::ctx.nativeDisplay, depth, width, height, &pixmap2));
+    ASSERT(pixmap2 == pixmap1);
+
+    /* Different size must not match */
+    ASSERT(nativeCreatePooledPixmap(util::ctx.nativeDisplay, depth, width, height + 1, &pixmap3));
+    ASSERT(pixmap3 != pixmap1);
+
+    /* The pixmaps must still be usable for rendering */
+    fillPixmap(pixmap2, width, height, depth);
+
+    nativeReleasePooledPixmap(util::ctx.nativeDisplay, pixmap2);
+    nativeReleasePooledPixmap(util::ctx.nativeDisplay, pixmap3);
+    nativeGetPixmapPoolUsage(util::ctx.nativeDisplay, &idleCount, &idleBytes);
+    ASSERT(idleCount == 2);
+
+    /* Only the most recently used pixmap fits under the new limit */
+    nativeSetPixmapPoolLimit(util::ctx.nativeDisplay, size + width * 4);
+    nativeGetPixmapPoolUsage(util::ctx.nativeDisplay, &idleCount, &idleBytes);
+    ASSERT(idleCount == 1);
+    ASSERT(idleBytes == size + width * 4);
+
+    nativeFlushPixmapPool(util::ctx.nativeDisplay);
+    nativeGetPixmapPoolUsage(util::ctx.nativeDisplay, &idleCount, &idleBytes);
+    ASSERT(idleCount == 0);
+    ASSERT(idleBytes == 0);
+}
+
+/**
+ *  Measure the cost of getting a fresh pixmap for every EGLImage binding
+ *  compared to recycling pixmaps through the pixmap pool.
+ *
+ *  Test loop:
+ *
+ *  1. Create a @width x @height x @depth pixmap, either directly or from the
+ *     pixmap pool when @pooled is set.
+ *  2. Create an EGLImage from the pixmap using EGL_NATIVE_PIXMAP_KHR.
+ *  3. Bind the EGLImage to a texture.
+ *  4. Draw a 1x1 quad using the texture and read a pixel to force rendering to
+ *     complete.
+ *  5. Destroy the EGLImage and destroy or release the pixmap.
+ *
+ *  The test result is the average time for allocation, image creation,
+ *  binding, rendering and release.
+ */
+void testPixmapAllocationLatency(int width, int height, int depth, bool pooled)
+{
+    EGLNativePixmapType pixmap;
+    EGLImageKHR image;
+    GLuint targetTexture;
+
+    int cycles = 64;
+    int64_t start, totalAllocation = 0, totalImageCreation = 0,
+            totalImageBinding = 0, totalRendering = 0, totalRelease = 0;
+    uint8_t color[4];
+
+    const EGLint imageAttributes[] =
+    {
+        EGL_IMAGE_PRESERVED_KHR, EGL_TRUE,
+        EGL_NONE
+    };
+
+    /* Leave room for a few idle pixmaps of this size */
+    nativeFlushPixmapPool(util::ctx.nativeDisplay);
+    nativeSetPixmapPoolLimit(util::ctx.nativeDisplay, 4 * width * height * 4);
+
+    glGenTextures(1, &targetTexture);
+    glBindTexture(GL_TEXTURE_2D, targetTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    for (int i = 0; i < cycles; i++)
+    {
+        /* Get a pixmap */
+        start = util::getTime();
+        if (pooled)
+        {
+            ASSERT(nativeCreatePooledPixmap(util::ctx.nativeDisplay, depth,
+                                            width, height, &pixmap));
+        }
+        else
+        {
+            ASSERT(nativeCreatePixmap(util::ctx.nativeDisplay, depth,
+                                      width, height, &pixmap));
+        }
+        totalAllocation += util::getTime() - start;
+
+        /* Bind the pixmap to an image */
+        start = util::getTime();
+        image = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT,
+                                  EGL_NATIVE_PIXMAP_KHR,
+                                  (EGLClientBuffer)(intptr_t)pixmap,
+                                  imageAttributes);
+        totalImageCreation += util::getTime() - start;
+        ASSERT_EGL();
+
+        /* Bind the image to a texture */
+        start = util::getTime();
+        glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+        totalImageBinding += util::getTime() - start;
+
+        /* Draw and read back a single pixel to make sure the texture is fully
+         * prepared
+         */
+        start = util::getTime();
+        glClear(GL_COLOR_BUFFER_BIT);
+        test::drawQuad(0, 0, 1, 1);
+        glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, color);
+        totalRendering += util::getTime() - start;
+
+        /* Give the pixmap back */
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, color);
+        eglDestroyImageKHR(util::ctx.dpy, image);
+        start = util::getTime();
+        if (pooled)
+        {
+            nativeReleasePooledPixmap(util::ctx.nativeDisplay, pixmap);
+        }
+        else
+        {
+            nativeDestroyPixmap(util::ctx.nativeDisplay, pixmap);
+        }
+        totalRelease += util::getTime() - start;
+
+        test::swapBuffers();
+        ASSERT_GL();
+        ASSERT_EGL();
+    }
+
+    printf("%lld us / %lld us / %lld us / %lld us / %lld us : ",
+            (long long)(totalAllocation / cycles / 1000),
+            (long long)(totalImageCreation / cycles / 1000),
+            (long long)(totalImageBinding / cycles / 1000),
+            (long long)(totalRendering / cycles / 1000),
+            (long long)(totalRelease / cycles / 1000));
+
+    /* Clean up */
+    glDeleteTextures(1, &targetTexture);
+    nativeFlushPixmapPool(util::ctx.nativeDisplay);
+}
+
+struct SyncTestContext
+{
+    test::scoped<Pixmap> pixmap;
+    pthread_mutex_t lock;
+    pthread_cond_t message;
+    int width, height;
+    bool done;
+    bool needContent;
+};
+
+/**
+ *  Offscreen rendering context of a worker thread. Rendering goes into a
+ *  pixmap through a framebuffer object backed by an EGLImage.
+ */
+struct PixmapRenderer
+{
+    EGLContext context;
+    EGLSurface dummySurface;
+    Pixmap dummyPixmap;
+    EGLImageKHR image;
+    GLuint renderbuffer;
+    GLuint framebuffer;
+    GLint program;
+};
+
+/**
+ *  Create a framebuffer that renders into @pixmap through an EGLImage-backed
+ *  renderbuffer and bind it in the current context
+ */
+static void createPixmapFramebuffer(Pixmap pixmap, EGLImageKHR* image,
+                                    GLuint* renderbuffer, GLuint* framebuffer)
+{
+    /* Create an EGLImage from the shared pixmap */
+    *image = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT, EGL_NATIVE_PIXMAP_KHR,
+                               (EGLClientBuffer)(intptr_t)pixmap, NULL);
+    ASSERT_EGL();
+
+    /* Bind the image to a renderbuffer */
+    glGenRenderbuffers(1, renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, *renderbuffer);
+    glEGLImageTargetRenderbufferStorageOES(GL_RENDERBUFFER, *image);
+    ASSERT_GL();
+
+    /* Bind the renderbuffer to a framebuffer */
+    glGenFramebuffers(1, framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, *framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, *renderbuffer);
+    ASSERT_GL();
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    ASSERT(status == GL_FRAMEBUFFER_COMPLETE);
+}
+
+/**
+ *  Create a rendering context for @pixmap and make it current in the calling
+ *  thread
+ */
+static void createPixmapRenderer(PixmapRenderer& renderer, Pixmap pixmap,
+                                 int width, int height)
+{
+    EGLConfig config;
+    EGLint configCount;
+
+    const EGLint configAttrs[] =
+    {
+        EGL_BUFFER_SIZE,     32,
+        EGL_SURFACE_TYPE,    EGL_PIXMAP_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE
+    };
+
+    const EGLint contextAttrs[] =
+    {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+
+    /* Create a dummy offscreen rendering surface */
+    ASSERT(nativeCreatePixmap(
+            util::ctx.nativeDisplay, 32, 64, 64, &renderer.dummyPixmap));
+
+    eglChooseConfig(util::ctx.dpy, configAttrs, &config, 1, &configCount);
+    ASSERT_EGL();
+    ASSERT(configCount == 1);
+
+    renderer.context = eglCreateContext(util::ctx.dpy, config, EGL_NO_CONTEXT,
+                                        contextAttrs);
+    ASSERT_EGL();
+
+    renderer.dummySurface = eglCreatePixmapSurface(util::ctx.dpy, config,
+                                                   renderer.dummyPixmap, NULL);
+    ASSERT_EGL();
+
+    eglMakeCurrent(util::ctx.dpy, renderer.dummySurface, renderer.dummySurface,
+                   renderer.context);
+    ASSERT_EGL();
+
+    createPixmapFramebuffer(pixmap, &renderer.image, &renderer.renderbuffer,
+                            &renderer.framebuffer);
+
+    /* Prepare blitter program */
+    renderer.program = util::createProgram(test::color::vertSource,
+                                           test::color::fragSource);
+    test::useProgram(renderer.program);
+    test::setViewport(0, 0, width, height);
+}
+
+/**
+ *  Release a rendering context created with createPixmapRenderer()
+ */
+static void destroyPixmapRenderer(PixmapRenderer& renderer)
+{
+    glDeleteRenderbuffers(1, &renderer.renderbuffer);
+    glDeleteFramebuffers(1, &renderer.framebuffer);
+    util::destroyProgram(renderer.program);
+    test::resetRenderState();
+
+    eglMakeCurrent(util::ctx.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+    eglDestroyImageKHR(util::ctx.dpy, renderer.image);
+    util::forgetPrograms(renderer.context);
+    eglDestroyContext(util::ctx.dpy, renderer.context);
+    eglDestroySurface(util::ctx.dpy, renderer.dummySurface);
+    nativeDestroyPixmap(util::ctx.nativeDisplay, renderer.dummyPixmap);
+    ASSERT_EGL();
+}
+
+/**
+ *  Fill the current framebuffer with non-red semi-complex rendering. The
+ *  colors depend on the frame number.
+ */
+static void renderTiles(test::QuadBatch& batch, int width, int height, int frame)
+{
+    int tileSize = 16;
+    for (int y = 0; y < height + tileSize; y += tileSize)
+    {
+        for (int x = 0; x < width + tileSize; x += tileSize)
+        {
+            bool green = frame & 0x1;
+            bool blue  = frame & 0x2;
+            batch.add(x, y, tileSize, tileSize,
+                    0.0f,
+                    green ? float(y) / height : 0.0f,
+                    blue  ? float(x) / width  : 0.0f);
+        }
+    }
+    batch.flush();
+}
+
+/**
+ *  Find a pixel in @pixels that renderTiles() could not have produced for
+ *  @frame, i.e., one that is too red or too bright.
+ *
+ *  @returns true and the position of the pixel if one was found.
+ */
+static bool findInvalidTilePixel(const uint32_t* pixels, int width, int height,
+                                 int frame, int* invalidX, int* invalidY)
+{
+    const uint8_t g1 = (frame & 0x1) ? 0xff : 0;
+    const uint8_t b1 = (frame & 0x2) ? 0xff : 0;
+    const int t = 8;
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            uint32_t p = pixels[y * width + x];
+            uint8_t r2 = (p & 0x000000ff);
+            uint8_t g2 = (p & 0x0000ff00) >> 8;
+            uint8_t b2 = (p & 0x00ff0000) >> 16;
+
+            if (r2 > t || g2 > g1 + t || b2 > b1 + t)
+            {
+                *invalidX = x;
+                *invalidY = y;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ *  Worker thread for the implicit synchronization test
+ */
+void* contentProducerThread(void* data)
+{
+    SyncTestContext* ctx = reinterpret_cast<SyncTestContext*>(data);
+    PixmapRenderer renderer;
+
+    createPixmapRenderer(renderer, ctx->pixmap, ctx->width, ctx->height);
+    {
+        test::QuadBatch batch;
+
+        int frame = 0;
+        while (1)
+        {
+            /* Wait for a content request */
+            pthread_mutex_lock(&ctx->lock);
+            while (!ctx->needContent && !ctx->done)
+            {
+                pthread_cond_wait(&ctx->message, &ctx->lock);
+            }
+            pthread_mutex_unlock(&ctx->lock);
+
+            if (ctx->done)
+            {
+                break;
+            }
+
+            /* Clear the pixmap with red (i.e., invalid color) */
+            GLubyte color[4];
+            glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, color);
+            ASSERT_GL();
+
+            /* Fill the pixmap with non-red semi-complex rendering */
+            renderTiles(batch, ctx->width, ctx->height, frame);
+
+            /* Flush and signal the main thread */
+            glFlush();
+            ctx->needContent = false;
+            pthread_cond_signal(&ctx->message);
+            frame++;
+        }
+    }
+    destroyPixmapRenderer(renderer);
+
+    return NULL;
+}
+
+/**
+ *  Test implicit render synchronization with pixmap-backed EGLImages.
+ *
+ *  Initialization:
+ *
+ *  1. Create a pixmap.
+ *  2. Create an EGLImage from the pixmap.
+ *  3. Spawn a thread and create render context on the pixmap by binding it to
+ *     an FBO using an EGLImage.
+ *
+ *  Test loop:
+ *
+ *  1. In the thread, render a solid red color into the pixmap and do a read
+ *     back to force rendering to complete.
+ *  2. Still in the thread, render semi-complex geometry into the pixmap using
+ *     other colors than red.
+ *  3. Call glFlush() and send a signal to the main thread.
+ *  4. In the main thread, bind the EGLImage into a texture and render it into
+ *     the window surface.
+ *  5. Check that no red pixels are visible in the window surface output.
+ */
+void testImplicitSync(int width, int height)
+{
+    boost::scoped_array<uint32_t> pixels(new uint32_t[width * height]);
+
+    SyncTestContext ctx;
+    ctx.pixmap = test::scoped<Pixmap>(
+            boost::bind(nativeDestroyPixmap, util::ctx.nativeDisplay, _1));
+    ctx.width = width;
+    ctx.height = height;
+    ctx.done = false;
+    ctx.needContent = false;
+
+    ASSERT(nativeCreatePixmap(
+            util::ctx.nativeDisplay, 32, ctx.width, ctx.height, &ctx.pixmap));
+
+    /* Create an EGLImage from the shared pixmap */
+    EGLImageKHR image;
+    image = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT, EGL_NATIVE_PIXMAP_KHR,
+                              (EGLClientBuffer)(intptr_t)ctx.pixmap, NULL);
+    ASSERT_EGL();
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    ASSERT_GL();
+
+    /* Start the producer */
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_cond_init(&ctx.message, NULL);
+    pthread_t thread;
+    pthread_create(&thread, NULL, contentProducerThread, &ctx);
+
+    for (int frame = 0; frame < 32; frame++)
+    {
+        /* Request content from the producer */
+        ctx.needContent = true;
+        pthread_cond_signal(&ctx.message);
+
+        /* Wait for content */
+        pthread_mutex_lock(&ctx.lock);
         while (ctx.needContent)
         {
-            pthread_cond_wait(&ctx.message, &ctx.lock);
+            pthread_cond_wait(&ctx.message, &ctx.lock);
+        }
+        pthread_mutex_unlock(&ctx.lock);
+
+        /* Bind the image to a texture */
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+
+        /* Render the texture to the screen */
+        glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        test::drawQuad(0, 0, width, height);
+
+        /* Check the results */
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+                     &pixels[0]);
+        ASSERT_GL();
+
+        int x, y;
+        if (findInvalidTilePixel(&pixels[0], width, height, frame, &x, &y))
+        {
+            ctx.done = true;
+            pthread_cond_signal(&ctx.message);
+            pthread_join(thread, NULL);
+            test::fail("Image comparison failed at (%d, %d), size (%d, %d), frame %d, "
+                       "got %08x\n", x, y, width, height, frame, pixels[y * width + x]);
+        }
+        test::swapBuffers();
+    }
+
+    ctx.done = true;
+    pthread_cond_signal(&ctx.message);
+    pthread_join(thread, NULL);
+
+    pthread_cond_destroy(&ctx.message);
+    pthread_mutex_destroy(&ctx.lock);
+}
+
+/** Maximum number of pixmaps in the implicit synchronization ring */
+static const int maxRingBuffers = 4;
+
+/** A pixmap in the implicit synchronization ring */
+struct RingBuffer
+{
+    Pixmap pixmap;
+    EGLImageKHR image;
+    GLuint texture;
+    int64_t submitTime;                 /** Time the producer flushed the contents */
+};
+
+/** State shared by the ring producer and consumer */
+struct RingTestContext
+{
+    RingBuffer buffers[maxRingBuffers];
+    int bufferCount;
+    int width, height;
+    int frames;
+    pthread_mutex_t lock;
+    pthread_cond_t produced;            /** Signaled when a buffer is filled */
+    pthread_cond_t consumed;            /** Signaled when a buffer is released */
+    int producedCount;
+    int consumedCount;
+    bool done;
+};
+
+/**
+ *  Producer thread for the implicit synchronization ring test
+ */
+void* ringProducerThread(void* data)
+{
+    RingTestContext* ctx = reinterpret_cast<RingTestContext*>(data);
+    PixmapRenderer renderer;
+    EGLImageKHR images[maxRingBuffers];
+    GLuint renderbuffers[maxRingBuffers];
+    GLuint framebuffers[maxRingBuffers];
+
+    createPixmapRenderer(renderer, ctx->buffers[0].pixmap, ctx->width, ctx->height);
+    images[0] = renderer.image;
+    renderbuffers[0] = renderer.renderbuffer;
+    framebuffers[0] = renderer.framebuffer;
+    for (int i = 1; i < ctx->bufferCount; i++)
+    {
+        createPixmapFramebuffer(ctx->buffers[i].pixmap, &images[i],
+                                &renderbuffers[i], &framebuffers[i]);
+    }
+    {
+        test::QuadBatch batch;
+
+        for (int frame = 0; frame < ctx->frames; frame++)
+        {
+            /* Wait for a free buffer */
+            pthread_mutex_lock(&ctx->lock);
+            while (ctx->producedCount - ctx->consumedCount >= ctx->bufferCount &&
+                   !ctx->done)
+            {
+                pthread_cond_wait(&ctx->consumed, &ctx->lock);
+            }
+            bool done = ctx->done;
+            pthread_mutex_unlock(&ctx->lock);
+
+            if (done)
+            {
+                break;
+            }
+
+            RingBuffer& buffer = ctx->buffers[frame % ctx->bufferCount];
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[frame % ctx->bufferCount]);
+
+            /* Clear the pixmap with red (i.e., invalid color) */
+            GLubyte color[4];
+            glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, color);
+            ASSERT_GL();
+
+            /* Fill the pixmap with non-red semi-complex rendering */
+            renderTiles(batch, ctx->width, ctx->height, frame);
+            glFlush();
+
+            /* Hand the buffer over to the consumer */
+            pthread_mutex_lock(&ctx->lock);
+            buffer.submitTime = util::getTime();
+            ctx->producedCount++;
+            pthread_cond_signal(&ctx->produced);
+            pthread_mutex_unlock(&ctx->lock);
+        }
+    }
+    for (int i = 1; i < ctx->bufferCount; i++)
+    {
+        glDeleteRenderbuffers(1, &renderbuffers[i]);
+        glDeleteFramebuffers(1, &framebuffers[i]);
+        eglDestroyImageKHR(util::ctx.dpy, images[i]);
+    }
+    destroyPixmapRenderer(renderer);
+
+    return NULL;
+}
+
+/**
+ *  Test implicit render synchronization with a ring of pixmap-backed
+ *  EGLImages and measure its throughput.
+ *
+ *  Initialization:
+ *
+ *  1. Create @bufferCount pixmaps and an EGLImage and a texture for each.
+ *  2. Spawn a producer thread and bind each pixmap to an FBO in its context.
+ *
+ *  Test loop:
+ *
+ *  1. In the thread, wait until a buffer is free. Render a solid red color
+ *     into it, do a read back and then render semi-complex geometry using
+ *     other colors than red.
+ *  2. Still in the thread, call glFlush() and hand the buffer over to the main
+ *     thread. Continue with the next buffer without waiting for the main
+ *     thread.
+ *  3. In the main thread, bind the oldest filled buffer into a texture and
+ *     render it into the window surface.
+ *  4. Check that no red pixels are visible in the window surface output and
+ *     release the buffer to the producer.
+ *
+ *  The test result is the frame rate and the average time from the producer
+ *  flushing a buffer to the main thread having verified it.
+ */
+void testImplicitSyncRing(int width, int height, int bufferCount)
+{
+    boost::scoped_array<uint32_t> pixels(new uint32_t[width * height]);
+    RingTestContext ctx;
+    int64_t latency = 0;
+    GLenum error = GL_NO_ERROR;
+    int invalidFrame = -1, invalidX = 0, invalidY = 0;
+
+    ASSERT(bufferCount > 0 && bufferCount <= maxRingBuffers);
+
+    ctx.bufferCount = bufferCount;
+    ctx.width = width;
+    ctx.height = height;
+    ctx.frames = 64;
+    ctx.producedCount = 0;
+    ctx.consumedCount = 0;
+    ctx.done = false;
+
+    for (int i = 0; i < bufferCount; i++)
+    {
+        RingBuffer& buffer = ctx.buffers[i];
+
+        ASSERT(nativeCreatePixmap(util::ctx.nativeDisplay, 32, width, height,
+                                  &buffer.pixmap));
+
+        buffer.image = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT,
+                                         EGL_NATIVE_PIXMAP_KHR,
+                                         (EGLClientBuffer)(intptr_t)buffer.pixmap, NULL);
+        ASSERT_EGL();
+
+        glGenTextures(1, &buffer.texture);
+        glBindTexture(GL_TEXTURE_2D, buffer.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        ASSERT_GL();
+    }
+
+    /* Start the producer */
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_cond_init(&ctx.produced, NULL);
+    pthread_cond_init(&ctx.consumed, NULL);
+    pthread_t thread;
+    pthread_create(&thread, NULL, ringProducerThread, &ctx);
+
+    int64_t start = util::getTime();
+    for (int frame = 0; frame < ctx.frames; frame++)
+    {
+        RingBuffer& buffer = ctx.buffers[frame % bufferCount];
+
+        /* Wait for the next filled buffer */
+        pthread_mutex_lock(&ctx.lock);
+        while (ctx.producedCount <= frame)
+        {
+            pthread_cond_wait(&ctx.produced, &ctx.lock);
         }
+        int64_t submitTime = buffer.submitTime;
         pthread_mutex_unlock(&ctx.lock);
 
-        /* Bind the image to a texture */
-        glBindTexture(GL_TEXTURE_2D, texture);
-        glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+        /* Render the buffer to the screen */
+        glBindTexture(GL_TEXTURE_2D, buffer.texture);
+        glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, buffer.image);
 
-        /* Render the texture to the screen */
         glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
         test::drawQuad(0, 0, width, height);
 
-        /* Check the results */
+        /* Check the results. Errors are only reported once the producer has
+         * been stopped, since it uses the synchronization objects on this
+         * stack frame. */
         glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
                      &pixels[0]);
-        ASSERT_GL();
+        error = glGetError();
+        latency += util::getTime() - submitTime;
 
-        for (int y = 0; y < height; y++)
+        if (error != GL_NO_ERROR ||
+            findInvalidTilePixel(&pixels[0], width, height, frame, &invalidX, &invalidY))
         {
-            for (int x = 0; x < width; x++)
-            {
-                /* Colors alternate as black, green, blue, green + blue */
-                uint8_t r1 = 0;
-                uint8_t g1 = (frame & 0x1) ? 0xff : 0;
-                uint8_t b1 = (frame & 0x2) ? 0xff : 0;
-                uint8_t a1 = 0xff;
-
-                uint32_t p = pixels[y * width + x];
-                uint8_t r2 = (p & 0x000000ff);
-                uint8_t g2 = (p & 0x0000ff00) >> 8;
-                uint8_t b2 = (p & 0x00ff0000) >> 16;
-                uint8_t a2 = (p & 0xff000000) >> 24;
-                int t = 8;
-
-                /* Make sure no invalid colors are present */
-                if (r2 > r1 + t ||
-                    g2 > g1 + t ||
-                    b2 > b1 + t ||
-                    a2 > a1 + t)
-                {
-                    ctx.done = true;
-                    pthread_cond_signal(&ctx.message);
-                    pthread_join(thread, NULL);
-                    test::fail("Image comparison failed at (%d, %d), size (%d, %d), expected %02x%02x%02x%02x, "
-                               "got %02x%02x%02x%02x\n", x, y, width, height, r1, g1, b1, a1,
-                               r2, g2, b2, a2);
-                }
-            }
+            invalidFrame = frame;
+            break;
         }
+
+        /* Release the buffer to the producer */
+        pthread_mutex_lock(&ctx.lock);
+        ctx.consumedCount++;
+        pthread_cond_signal(&ctx.consumed);
+        pthread_mutex_unlock(&ctx.lock);
+
         test::swapBuffers();
     }
+    int64_t time = util::getTime() - start;
 
+    pthread_mutex_lock(&ctx.lock);
     ctx.done = true;
-    pthread_cond_signal(&ctx.message);
+    pthread_cond_signal(&ctx.consumed);
+    pthread_mutex_unlock(&ctx.lock);
     pthread_join(thread, NULL);
 
-    pthread_cond_destroy(&ctx.message);
+    pthread_cond_destroy(&ctx.consumed);
+    pthread_cond_destroy(&ctx.produced);
     pthread_mutex_destroy(&ctx.lock);
+
+    for (int i = 0; i < bufferCount; i++)
+    {
+        glDeleteTextures(1, &ctx.buffers[i].texture);
+        eglDestroyImageKHR(util::ctx.dpy, ctx.buffers[i].image);
+        nativeDestroyPixmap(util::ctx.nativeDisplay, ctx.buffers[i].pixmap);
+    }
+
+    if (error != GL_NO_ERROR)
+    {
+        test::fail("GL error 0x%x in frame %d\n", error, invalidFrame);
+    }
+    if (invalidFrame >= 0)
+    {
+        test::fail("Image comparison failed at (%d, %d), frame %d with %d buffers, "
+                   "got %08x\n", invalidX, invalidY, invalidFrame, bufferCount,
+                   pixels[invalidY * width + invalidX]);
+    }
+    ASSERT_EGL();
+
+    printf("%.1f frames/s, %lld us latency : ",
+           (double)ctx.frames / (time / 1e9),
+           (long long)(latency / ctx.frames / 1000));
+}
+
+/** State shared by the scalability benchmark threads */
+struct ScalabilityContext
+{
+    pthread_mutex_t lock;
+    pthread_cond_t request;             /** Signaled when new frames are needed */
+    pthread_cond_t response;            /** Signaled when a worker finishes a frame */
+    int pending;                        /** Workers still rendering the frame */
+    int frame;                          /** Number of the requested frame */
+    int64_t requestTime;                /** Time the current frame was requested */
+    bool done;
+};
+
+/**
+ *  Scalability benchmark worker thread. Each worker renders into two pixmaps
+ *  in turn so that the next frame can be rendered while the previous one is
+ *  being composited.
+ */
+struct ScalabilityWorker
+{
+    ScalabilityContext* shared;
+    pthread_t thread;
+    Pixmap pixmaps[2];
+    EGLImageKHR images[2];
+    GLuint textures[2];
+    int width, height;
+    bool needContent;
+    int64_t latency;                    /** Sum of request to completion times */
+    int64_t worstLatency;
+};
+
+/**
+ *  Worker thread for the rendering scalability benchmark
+ */
+void* scalabilityWorkerThread(void* data)
+{
+    ScalabilityWorker* worker = reinterpret_cast<ScalabilityWorker*>(data);
+    ScalabilityContext* shared = worker->shared;
+    PixmapRenderer renderer;
+    EGLImageKHR backImage;
+    GLuint backRenderbuffer;
+    GLuint framebuffers[2];
+
+    createPixmapRenderer(renderer, worker->pixmaps[0], worker->width, worker->height);
+    createPixmapFramebuffer(worker->pixmaps[1], &backImage, &backRenderbuffer,
+                            &framebuffers[1]);
+    framebuffers[0] = renderer.framebuffer;
+    {
+        test::QuadBatch batch;
+
+        while (1)
+        {
+            pthread_mutex_lock(&shared->lock);
+            while (!worker->needContent && !shared->done)
+            {
+                pthread_cond_wait(&shared->request, &shared->lock);
+            }
+            int frame = shared->frame;
+            int64_t requestTime = shared->requestTime;
+            bool done = shared->done;
+            pthread_mutex_unlock(&shared->lock);
+
+            if (done)
+            {
+                break;
+            }
+
+            glBindFramebuffer(GL_FRAMEBUFFER, framebuffers[frame % 2]);
+            glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            renderTiles(batch, worker->width, worker->height, frame);
+
+            /* Include the GPU time in the latency */
+            glFinish();
+            int64_t latency = util::getTime() - requestTime;
+            worker->latency += latency;
+            worker->worstLatency = std::max(worker->worstLatency, latency);
+
+            pthread_mutex_lock(&shared->lock);
+            worker->needContent = false;
+            shared->pending--;
+            pthread_cond_signal(&shared->response);
+            pthread_mutex_unlock(&shared->lock);
+        }
+    }
+    glDeleteRenderbuffers(1, &backRenderbuffer);
+    glDeleteFramebuffers(1, &framebuffers[1]);
+    eglDestroyImageKHR(util::ctx.dpy, backImage);
+    destroyPixmapRenderer(renderer);
+
+    return NULL;
+}
+
+/**
+ *  Request frame @frame from all scalability workers
+ */
+static void requestScalabilityFrame(ScalabilityContext& shared, ScalabilityWorker* workers,
+                                    int threadCount, int frame)
+{
+    pthread_mutex_lock(&shared.lock);
+    shared.frame = frame;
+    shared.requestTime = util::getTime();
+    shared.pending = threadCount;
+    for (int i = 0; i < threadCount; i++)
+    {
+        workers[i].needContent = true;
+    }
+    pthread_cond_broadcast(&shared.request);
+    pthread_mutex_unlock(&shared.lock);
+}
+
+/**
+ *  Measure how rendering from multiple threads scales.
+ *
+ *  Initialization:
+ *
+ *  1. Create two @width x @height pixmaps for each of @threadCount workers
+ *     and EGLImages for them.
+ *  2. Spawn a worker thread for each pixmap pair. Each worker creates its own
+ *     context and binds its pixmaps to FBOs using the EGLImages.
+ *  3. Disable swap throttling so that the display refresh rate does not limit
+ *     the frame rate.
+ *
+ *  Test loop:
+ *
+ *  1. Wait until all workers have rendered the current frame into one of
+ *     their pixmaps and waited for it to complete with glFinish().
+ *  2. Request the next frame from all workers at once. The workers render it
+ *     into their other pixmap.
+ *  3. Meanwhile, bind the current frame of each worker to a texture in the
+ *     main thread and composite all of them into the window in a grid.
+ *  4. Swap buffers.
+ *
+ *  The test results are the aggregate number of frames rendered per second by
+ *  all workers together, the average time from a frame request to its
+ *  completion for each worker and the worst such time over all workers.
+ */
+void testRenderingScalability(int threadCount, int width, int height)
+{
+    const int frames = 64;
+    ScalabilityContext shared;
+    boost::scoped_array<ScalabilityWorker> workers(new ScalabilityWorker[threadCount]);
+    EGLint surfaceWidth, surfaceHeight;
+    GLenum error = GL_NO_ERROR;
+
+    eglQuerySurface(util::ctx.dpy, util::ctx.surface, EGL_WIDTH, &surfaceWidth);
+    eglQuerySurface(util::ctx.dpy, util::ctx.surface, EGL_HEIGHT, &surfaceHeight);
+
+    int columns = 1;
+    while (columns * columns < threadCount)
+    {
+        columns++;
+    }
+    int rows = (threadCount + columns - 1) / columns;
+
+    /* Create all resources before starting any thread so that nothing can
+     * fail while the workers are running */
+    for (int i = 0; i < threadCount; i++)
+    {
+        ScalabilityWorker& worker = workers[i];
+
+        worker.shared = &shared;
+        worker.width = width;
+        worker.height = height;
+        worker.needContent = false;
+        worker.latency = 0;
+        worker.worstLatency = 0;
+
+        for (int j = 0; j < 2; j++)
+        {
+            ASSERT(nativeCreatePixmap(util::ctx.nativeDisplay, 32, width, height,
+                                      &worker.pixmaps[j]));
+
+            worker.images[j] = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT,
+                                                 EGL_NATIVE_PIXMAP_KHR,
+                                                 (EGLClientBuffer)(intptr_t)worker.pixmaps[j],
+                                                 NULL);
+            ASSERT_EGL();
+
+            glGenTextures(1, &worker.textures[j]);
+            glBindTexture(GL_TEXTURE_2D, worker.textures[j]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            ASSERT_GL();
+        }
+    }
+
+    pthread_mutex_init(&shared.lock, NULL);
+    pthread_cond_init(&shared.request, NULL);
+    pthread_cond_init(&shared.response, NULL);
+    shared.pending = 0;
+    shared.frame = 0;
+    shared.requestTime = 0;
+    shared.done = false;
+
+    for (int i = 0; i < threadCount; i++)
+    {
+        pthread_create(&workers[i].thread, NULL, scalabilityWorkerThread, &workers[i]);
+    }
+
+    eglSwapInterval(util::ctx.dpy, 0);
+
+    int64_t start = util::getTime();
+    requestScalabilityFrame(shared, &workers[0], threadCount, 0);
+    for (int frame = 0; frame < frames; frame++)
+    {
+        /* Wait for the current frame from all workers */
+        pthread_mutex_lock(&shared.lock);
+        while (shared.pending)
+        {
+            pthread_cond_wait(&shared.response, &shared.lock);
+        }
+        pthread_mutex_unlock(&shared.lock);
+
+        /* Let the workers render the next frame while this one is composited */
+        if (frame + 1 < frames)
+        {
+            requestScalabilityFrame(shared, &workers[0], threadCount, frame + 1);
+        }
+
+        /* Composite the results */
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        for (int i = 0; i < threadCount; i++)
+        {
+            int tileWidth = surfaceWidth / columns;
+            int tileHeight = surfaceHeight / rows;
+
+            glBindTexture(GL_TEXTURE_2D, workers[i].textures[frame % 2]);
+            glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, workers[i].images[frame % 2]);
+            test::drawQuad((i % columns) * tileWidth, (i / columns) * tileHeight,
+                           tileWidth, tileHeight);
+        }
+
+        /* Stop the workers before reporting errors */
+        error = glGetError();
+        if (error != GL_NO_ERROR)
+        {
+            break;
+        }
+        test::swapBuffers();
+    }
+    int64_t time = util::getTime() - start;
+
+    eglSwapInterval(util::ctx.dpy, 1);
+
+    pthread_mutex_lock(&shared.lock);
+    shared.done = true;
+    pthread_cond_broadcast(&shared.request);
+    pthread_mutex_unlock(&shared.lock);
+
+    std::string latencies;
+    int64_t worstLatency = 0;
+    for (int i = 0; i < threadCount; i++)
+    {
+        char latency[32];
+
+        pthread_join(workers[i].thread, NULL);
+        snprintf(latency, sizeof(latency), "%s%lld", i ? "/" : "",
+                 (long long)(workers[i].latency / frames / 1000));
+        latencies += latency;
+        worstLatency = std::max(worstLatency, workers[i].worstLatency);
+
+        for (int j = 0; j < 2; j++)
+        {
+            glDeleteTextures(1, &workers[i].textures[j]);
+            eglDestroyImageKHR(util::ctx.dpy, workers[i].images[j]);
+            nativeDestroyPixmap(util::ctx.nativeDisplay, workers[i].pixmaps[j]);
+        }
+    }
+
+    pthread_cond_destroy(&shared.response);
+    pthread_cond_destroy(&shared.request);
+    pthread_mutex_destroy(&shared.lock);
+
+    if (error != GL_NO_ERROR)
+    {
+        test::fail("GL error 0x%x while compositing\n", error);
+    }
+    ASSERT_GL();
+    ASSERT_EGL();
+
+    printf("%.1f frames/s, %s us latency, %lld us worst : ",
+           (double)frames * threadCount / (time / 1e9),
+           latencies.c_str(), (long long)(worstLatency / 1000));
 }
 
 int main(int argc, char** argv)
 {
     bool result;
+    int maxThreads;
     int winWidth = 864;
     int winHeight = 480;
     int winDepth = 16;
 
+    const char* eglExtensions[] = {"EGL_KHR_image_base", "EGL_KHR_image_pixmap", NULL};
+
+    if (test::skipUnsupported(eglExtensions, NULL))
+    {
+        return 1;
+    }
+
     EGLNativeDisplayType dpy;
     nativeCreateDisplay(&dpy);
     nativeGetDisplayProperties(dpy, &winWidth, &winHeight, &winDepth);
@@ -920,8 +2128,26 @@ int main(int argc, char** argv)
         1024
     };
 
+    /* Square, non-square and odd sizes for the binding latency matrix */
+    struct
+    {
+        int width;
+        int height;
+    } latencySizes[] =
+    {
+        {16,     16},
+        {256,   256},
+        {1024, 1024},
+        {113,    47},
+        {1023,  767},
+    };
+
+    const int depths[] = {16, 24, 32};
+
+    const int reuseSizes[] = {64, 256, 1024};
+
     GLint program = util::createProgram(test::vertSource, test::fragSource);
-    glUseProgram(program);
+    test::useProgram(program);
 
     test::printHeader("Testing extension presence");
     result = test::verifyResult(testExtensionPresence);
@@ -961,13 +2187,91 @@ int main(int argc, char** argv)
     test::printHeader("Testing implicit synchronization");
     result &= test::verifyResult(boost::bind(testImplicitSync, winWidth, winHeight));
 
+    for (int buffers = 1; buffers <= 3; buffers++)
+    {
+        test::printHeader("Testing implicit synchronization (%d buffers)", buffers);
+        result &= test::verifyResult(
+                boost::bind(testImplicitSyncRing, winWidth, winHeight, buffers));
+    }
+
+    /* Limit the thread count to keep the run time reasonable */
+    maxThreads = std::min(std::max((int)sysconf(_SC_NPROCESSORS_ONLN), 1), 16);
+    for (int threads = 1; threads <= maxThreads; threads++)
+    {
+        test::printHeader("Testing rendering scalability (%d threads)", threads);
+        result &= test::verifyResult(
+                boost::bind(testRenderingScalability, threads, 256, 256));
+    }
+
+    for (int source = SourcePixmap; source <= SourceRenderbuffer; source++)
+    {
+        for (unsigned int i = 0; i < sizeof(latencySizes) / sizeof(latencySizes[0]); i++)
+        {
+            for (unsigned int j = 0; j < sizeof(depths) / sizeof(depths[0]); j++)
+            {
+                if (!isImageSourceSupported((ImageSource)source, depths[j]))
+                {
+                    continue;
+                }
+                for (int preserved = 1; preserved >= 0; preserved--)
+                {
+                    test::printHeader("Testing binding latency (%s %dx%d %dbpp%s)",
+                            imageSourceName((ImageSource)source),
+                            latencySizes[i].width, latencySizes[i].height,
+                            depths[j], preserved ? ", preserved" : "");
+
+                    result &= test::verifyResult(
+                            boost::bind(testMappingLatency, (ImageSource)source,
+                                        latencySizes[i].width,
+                                        latencySizes[i].height,
+                                        depths[j], (bool)preserved));
+                }
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < sizeof(reuseSizes) / sizeof(reuseSizes[0]); i++)
+    {
+        for (int reuse = ReuseRecreate; reuse <= ReuseBound; reuse++)
+        {
+            test::printHeader("Testing image %s latency (%dx%d 32bpp)",
+                    imageReuseName((ImageReuse)reuse), reuseSizes[i], reuseSizes[i]);
+
+            result &= test::verifyResult(
+                    boost::bind(testImageReuseLatency, reuseSizes[i], reuseSizes[i],
+                                (ImageReuse)reuse));
+        }
+    }
+
+    for (unsigned int i = 0; i < sizeof(reuseSizes) / sizeof(reuseSizes[0]); i++)
+    {
+        for (int update = UpdatePutImage; update <= UpdateCopyArea; update++)
+        {
+            test::printHeader("Testing %s visibility latency (%dx%d 32bpp)",
+                    pixmapUpdateName((PixmapUpdate)update), reuseSizes[i], reuseSizes[i]);
+
+            result &= test::verifyResult(
+                    boost::bind(testPixmapVisibilityLatency, reuseSizes[i], reuseSizes[i],
+                                (PixmapUpdate)update));
+        }
+    }
+
+    test::printHeader("Testing pixmap pool");
+    result &= test::verifyResult(testPixmapPool);
+
     for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
     {
-        test::printHeader("Testing binding latency (%dx%d 32bpp)",
+        test::printHeader("Testing fresh pixmap latency (%dx%d 32bpp)",
+                 sizes[i], sizes[i]);
+
+        result &= test::verifyResult(
+                boost::bind(testPixmapAllocationLatency, sizes[i], sizes[i], 32, false));
+
+        test::printHeader("Testing pooled pixmap latency (%dx%d 32bpp)",
                  sizes[i], sizes[i]);
 
         result &= test::verifyResult(
-                boost::bind(testMappingLatency, sizes[i], sizes[i]));
+                boost::bind(testPixmapAllocationLatency, sizes[i], sizes[i], 32, true));
     }
 
     colorPattern = 0;
@@ -980,7 +2284,7 @@ int main(int argc, char** argv)
     test::swapBuffers();
 
 out:
-    glDeleteProgram(program);
+    util::destroyProgram(program);
     util::destroyWindow();
 
     printf("================================================\n");
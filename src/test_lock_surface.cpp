@@ -533,6 +533,13 @@ int main(int argc, char** argv)
 {
     bool result;
 
+    const char* eglExtensions[] = {"EGL_KHR_lock_surface", "EGL_KHR_lock_surface2", NULL};
+
+    if (test::skipUnsupported(eglExtensions, NULL))
+    {
+        return 1;
+    }
+
     nativeCreateDisplay(&nativeDisplay);
     nativeGetDisplayProperties(nativeDisplay, &winWidth, &winHeight, &winDepth);
 
@@ -560,7 +567,7 @@ int main(int argc, char** argv)
     ASSERT_EGL();
 
     GLint program = util::createProgram(test::vertSource, test::fragSource);
-    glUseProgram(program);
+    test::useProgram(program);
 
     test::printHeader("Testing extension presence");
     result = test::verifyResult(testExtensionPresence);
@@ -573,7 +580,7 @@ int main(int argc, char** argv)
     result &= test::verify(testWindowSurfaces);
     result &= test::verify(testPixmapSurfaces);
 out:
-    glDeleteProgram(program);
+    util::destroyProgram(program);
     util::destroyWindow();
     eglTerminate(dpy);
     nativeDestroyDisplay(nativeDisplay);
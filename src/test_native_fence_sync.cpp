@@ -0,0 +1,502 @@
+/**
+ * EGL_ANDROID_native_fence_sync test
+ * Copyright (C) 2010 Nokia
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * \author Sami Kyöstilä <sami.kyostila@nokia.com>
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include <vector>
+
+#include "ext.h"
+#include "native.h"
+#include "util.h"
+#include "testutil.h"
+
+static PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
+static PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
+static PFNEGLCLIENTWAITSYNCKHRPROC eglClientWaitSyncKHR;
+static PFNEGLGETSYNCATTRIBKHRPROC eglGetSyncAttribKHR;
+static PFNEGLDUPNATIVEFENCEFDANDROIDPROC eglDupNativeFenceFDANDROID;
+
+/** Number of idle file descriptors the event loop watches besides the fence */
+static const int idleDescriptors = 8;
+
+/**
+ * Verify that the needed extensions are present
+ */
+void testExtensionPresence()
+{
+    ASSERT(util::isEGLExtensionSupported("EGL_KHR_fence_sync"));
+    ASSERT(util::isEGLExtensionSupported("EGL_ANDROID_native_fence_sync"));
+
+    eglCreateSyncKHR =
+        (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    eglDestroySyncKHR =
+        (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    eglClientWaitSyncKHR =
+        (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+    eglGetSyncAttribKHR =
+        (PFNEGLGETSYNCATTRIBKHRPROC)eglGetProcAddress("eglGetSyncAttribKHR");
+    eglDupNativeFenceFDANDROID =
+        (PFNEGLDUPNATIVEFENCEFDANDROIDPROC)eglGetProcAddress("eglDupNativeFenceFDANDROID");
+
+    ASSERT(eglCreateSyncKHR);
+    ASSERT(eglDestroySyncKHR);
+    ASSERT(eglClientWaitSyncKHR);
+    ASSERT(eglGetSyncAttribKHR);
+    ASSERT(eglDupNativeFenceFDANDROID);
+}
+
+/**
+ *  @returns the value of a sync object attribute
+ */
+static EGLint getSyncAttrib(EGLSyncKHR sync, EGLint attribute)
+{
+    EGLint value = 0;
+    EGLBoolean success = eglGetSyncAttribKHR(util::ctx.dpy, sync, attribute, &value);
+    ASSERT_EGL();
+    ASSERT(success);
+    return value;
+}
+
+/**
+ *  @returns a sync file descriptor for the commands issued so far
+ */
+static int createFenceFd()
+{
+    int fd = util::exportFenceFd(util::ctx.dpy);
+    ASSERT_EGL();
+    ASSERT(fd != EGL_NO_NATIVE_FENCE_FD_ANDROID);
+    return fd;
+}
+
+/**
+ *  Test known invalid inputs.
+ *
+ *  1. Try to export a regular fence sync as a file descriptor.
+ *  2. Try to export a native fence sync before it has been flushed.
+ */
+void testFailureCases()
+{
+    EGLSyncKHR sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_FENCE_KHR, NULL);
+    ASSERT_EGL();
+
+    ASSERT(eglDupNativeFenceFDANDROID(util::ctx.dpy, sync) == EGL_NO_NATIVE_FENCE_FD_ANDROID);
+    ASSERT(eglGetError() == EGL_BAD_PARAMETER);
+
+    eglDestroySyncKHR(util::ctx.dpy, sync);
+    ASSERT_EGL();
+
+    sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_NATIVE_FENCE_ANDROID, NULL);
+    ASSERT_EGL();
+
+    ASSERT(eglDupNativeFenceFDANDROID(util::ctx.dpy, sync) == EGL_NO_NATIVE_FENCE_FD_ANDROID);
+    ASSERT(eglGetError() == EGL_BAD_PARAMETER);
+
+    eglDestroySyncKHR(util::ctx.dpy, sync);
+    ASSERT_EGL();
+}
+
+/**
+ *  Test exporting a fence as a file descriptor.
+ *
+ *  1. Render and place a native fence sync.
+ *  2. Check the sync object attributes.
+ *  3. Flush and export the fence as a file descriptor.
+ *  4. Wait for the file descriptor to become readable with poll().
+ *  5. Check that the sync object is signaled.
+ */
+void testExportFence()
+{
+    glClearColor(.8, .2, .1, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    EGLSyncKHR sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_NATIVE_FENCE_ANDROID, NULL);
+    ASSERT_EGL();
+
+    ASSERT(getSyncAttrib(sync, EGL_SYNC_TYPE_KHR) == EGL_SYNC_NATIVE_FENCE_ANDROID);
+    ASSERT(getSyncAttrib(sync, EGL_SYNC_CONDITION_KHR) ==
+           EGL_SYNC_NATIVE_FENCE_SIGNALED_ANDROID);
+
+    glFlush();
+    int fd = eglDupNativeFenceFDANDROID(util::ctx.dpy, sync);
+    ASSERT_EGL();
+    ASSERT(fd != EGL_NO_NATIVE_FENCE_FD_ANDROID);
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int ret = poll(&pfd, 1, 1000);
+    close(fd);
+
+    ASSERT(ret == 1);
+    ASSERT(pfd.revents & POLLIN);
+    ASSERT(getSyncAttrib(sync, EGL_SYNC_STATUS_KHR) == EGL_SIGNALED_KHR);
+
+    eglDestroySyncKHR(util::ctx.dpy, sync);
+    ASSERT_EGL();
+}
+
+/**
+ *  Test importing a sync file as a sync object.
+ *
+ *  1. Render and export a fence as a file descriptor.
+ *  2. Create a native fence sync from the file descriptor, passing its
+ *     ownership to EGL.
+ *  3. Wait for the imported sync with eglClientWaitSyncKHR.
+ *  4. Export the imported sync again and check that the result is readable.
+ */
+void testImportFence()
+{
+    glClearColor(.2, .8, .1, 1.0);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    const EGLint attrs[] =
+    {
+        EGL_SYNC_NATIVE_FENCE_FD_ANDROID, createFenceFd(),
+        EGL_NONE
+    };
+
+    EGLSyncKHR sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_NATIVE_FENCE_ANDROID, attrs);
+    ASSERT_EGL();
+    ASSERT(sync != EGL_NO_SYNC_KHR);
+
+    EGLint ret = eglClientWaitSyncKHR(util::ctx.dpy, sync, 0, 1000ull * 1000 * 1000);
+    ASSERT_EGL();
+    ASSERT(ret == EGL_CONDITION_SATISFIED_KHR);
+
+    int fd = eglDupNativeFenceFDANDROID(util::ctx.dpy, sync);
+    ASSERT_EGL();
+    ASSERT(fd != EGL_NO_NATIVE_FENCE_FD_ANDROID);
+
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    int pollRet = poll(&pfd, 1, 0);
+    close(fd);
+    ASSERT(pollRet == 1);
+
+    eglDestroySyncKHR(util::ctx.dpy, sync);
+    ASSERT_EGL();
+}
+
+/** Ways for an event loop to wait for rendering to complete */
+enum EventLoopWait
+{
+    WaitPoll,           /** poll() on the sync file */
+    WaitEpoll,          /** epoll_wait() on the sync file */
+    WaitThread          /** eglClientWaitSyncKHR in a dedicated thread */
+};
+
+/** Pipes between the event loop and the waiter thread */
+struct WaiterThread
+{
+    int request[2];                     /** Syncs to wait for */
+    int done[2];                        /** A byte per completed wait */
+};
+
+/**
+ *  Thread which waits for sync objects on behalf of the event loop
+ */
+void* fenceWaiterThread(void* data)
+{
+    WaiterThread* waiter = reinterpret_cast<WaiterThread*>(data);
+    EGLSyncKHR sync;
+
+    while (read(waiter->request[0], &sync, sizeof(sync)) == sizeof(sync) && sync)
+    {
+        char result = eglClientWaitSyncKHR(util::ctx.dpy, sync, 0, EGL_FOREVER_KHR) ==
+                      EGL_CONDITION_SATISFIED_KHR;
+        if (write(waiter->done[1], &result, 1) != 1)
+        {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ *  Poll a set of file descriptors until the first one becomes readable. The
+ *  rest are never expected to become readable.
+ *
+ *  @returns true if the first file descriptor became readable within a second
+ */
+static bool waitFirstReadable(std::vector<struct pollfd>& pfds)
+{
+    return poll(&pfds[0], pfds.size(), 1000) == 1 && (pfds[0].revents & POLLIN);
+}
+
+/**
+ *  Measure waiting for rendering to complete in an event loop which also
+ *  watches other file descriptors.
+ *
+ *  Initialization:
+ *
+ *  1. Create a number of idle pipes for the event loop to watch.
+ *  2. For WaitEpoll, create an epoll instance watching the idle pipes.
+ *  3. For WaitThread, start a waiter thread.
+ *
+ *  Test loop:
+ *
+ *  1. Render a frame and place a fence after it.
+ *  2. Wait for the fence according to @mode:
+ *     - WaitPoll: export the fence as a sync file and poll() it together with
+ *       the idle pipes.
+ *     - WaitEpoll: export the fence as a sync file, add it to the epoll
+ *       instance, wait for it with epoll_wait() and remove it.
+ *     - WaitThread: pass the sync object to the waiter thread, which waits for
+ *       it with eglClientWaitSyncKHR and writes to a pipe that is polled
+ *       together with the idle pipes.
+ *  3. Swap buffers.
+ *
+ *  The test results are the number of frames per second, the average and 99th
+ *  percentile time spent in the event loop waiting for each frame and the
+ *  process CPU time per frame, which includes the waiter thread.
+ */
+void testEventLoopWait(EventLoopWait mode)
+{
+    const int frames = 128;
+    const int quads = 16;
+    std::vector<int> idle(idleDescriptors * 2);
+    std::vector<struct pollfd> pfds(idleDescriptors + 1);
+    util::Samples waitTime;
+    WaiterThread waiter;
+    pthread_t thread;
+    int epollFd = -1;
+    EGLint width, height;
+    bool failed = false;
+
+    eglQuerySurface(util::ctx.dpy, util::ctx.surface, EGL_WIDTH, &width);
+    eglQuerySurface(util::ctx.dpy, util::ctx.surface, EGL_HEIGHT, &height);
+
+    for (int i = 0; i < idleDescriptors; i++)
+    {
+        ASSERT(pipe(&idle[i * 2]) == 0);
+        pfds[i + 1].fd = idle[i * 2];
+        pfds[i + 1].events = POLLIN;
+    }
+
+    if (mode == WaitEpoll)
+    {
+        epollFd = epoll_create(idleDescriptors + 1);
+        ASSERT(epollFd >= 0);
+
+        for (int i = 0; i < idleDescriptors; i++)
+        {
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.events = EPOLLIN;
+            event.data.fd = idle[i * 2];
+            ASSERT(epoll_ctl(epollFd, EPOLL_CTL_ADD, idle[i * 2], &event) == 0);
+        }
+    }
+    else if (mode == WaitThread)
+    {
+        ASSERT(pipe(waiter.request) == 0);
+        ASSERT(pipe(waiter.done) == 0);
+        pthread_create(&thread, NULL, fenceWaiterThread, &waiter);
+    }
+
+    int64_t start = util::getTime();
+    int64_t startCPU = util::getCPUTime();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        glClearColor(0.0, float(frame % 16) / 16, 0.0, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        for (int i = 0; i < quads; i++)
+        {
+            test::drawQuad(0, 0, width, height);
+        }
+
+        int64_t waitStart = util::getTime();
+        if (mode == WaitThread)
+        {
+            EGLSyncKHR sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_FENCE_KHR, NULL);
+            glFlush();
+            waitStart = util::getTime();
+            failed |= (write(waiter.request[1], &sync, sizeof(sync)) != sizeof(sync));
+
+            pfds[0].fd = waiter.done[0];
+            pfds[0].events = POLLIN;
+            failed |= !waitFirstReadable(pfds);
+
+            char result = 0;
+            failed |= (read(waiter.done[0], &result, 1) != 1 || !result);
+            eglDestroySyncKHR(util::ctx.dpy, sync);
+        }
+        else
+        {
+            int fd = createFenceFd();
+            waitStart = util::getTime();
+
+            if (mode == WaitPoll)
+            {
+                pfds[0].fd = fd;
+                pfds[0].events = POLLIN;
+                failed |= !waitFirstReadable(pfds);
+            }
+            else
+            {
+                struct epoll_event event;
+                memset(&event, 0, sizeof(event));
+                event.events = EPOLLIN;
+                event.data.fd = fd;
+                failed |= (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0);
+
+                do
+                {
+                    failed |= (epoll_wait(epollFd, &event, 1, 1000) != 1);
+                } while (!failed && event.data.fd != fd);
+
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, &event);
+            }
+            close(fd);
+        }
+        waitTime.add(util::getTime() - waitStart);
+
+        test::swapBuffers();
+        if (failed)
+        {
+            break;
+        }
+    }
+    int64_t time = util::getTime() - start;
+    int64_t cpuTime = util::getCPUTime() - startCPU;
+
+    if (mode == WaitEpoll)
+    {
+        close(epollFd);
+    }
+    else if (mode == WaitThread)
+    {
+        EGLSyncKHR stop = EGL_NO_SYNC_KHR;
+        if (write(waiter.request[1], &stop, sizeof(stop)) == sizeof(stop))
+        {
+            pthread_join(thread, NULL);
+        }
+        close(waiter.request[0]);
+        close(waiter.request[1]);
+        close(waiter.done[0]);
+        close(waiter.done[1]);
+    }
+
+    for (int i = 0; i < idleDescriptors * 2; i++)
+    {
+        close(idle[i]);
+    }
+
+    ASSERT_GL();
+    ASSERT_EGL();
+    ASSERT(!failed);
+
+    printf("%.1f frames/s, %lld us wait, %lld us 99%%, %lld us CPU/frame : ",
+            frames / (time / 1e9),
+            (long long)(waitTime.mean() / 1000),
+            (long long)(waitTime.percentile(99) / 1000),
+            (long long)(cpuTime / frames / 1000));
+}
+
+int main(int argc, char** argv)
+{
+    bool result;
+    int winWidth = 864;
+    int winHeight = 480;
+    int winDepth = 16;
+
+    const char* eglExtensions[] =
+    {
+        "EGL_KHR_fence_sync",
+        "EGL_ANDROID_native_fence_sync",
+        NULL
+    };
+
+    if (test::skipUnsupported(eglExtensions, NULL))
+    {
+        return 1;
+    }
+
+    EGLNativeDisplayType dpy;
+    nativeCreateDisplay(&dpy);
+    nativeGetDisplayProperties(dpy, &winWidth, &winHeight, &winDepth);
+    nativeDestroyDisplay(dpy);
+
+    const EGLint configAttrs[] =
+    {
+        EGL_BUFFER_SIZE,     winDepth,
+        EGL_SURFACE_TYPE,    EGL_WINDOW_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE
+    };
+
+    const EGLint contextAttrs[] =
+    {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+
+    result = util::createWindow(winWidth, winHeight, configAttrs, contextAttrs);
+    ASSERT(result);
+    ASSERT_EGL();
+
+    GLint program = util::createProgram(test::vertSource, test::fragSource);
+    test::useProgram(program);
+    ASSERT_GL();
+
+    test::printHeader("Testing extension presence");
+    result &= test::verifyResult(testExtensionPresence);
+
+    if (!result)
+    {
+        goto out;
+    }
+
+    test::printHeader("Testing failure cases");
+    result &= test::verifyResult(testFailureCases);
+    test::printHeader("Testing fence export");
+    result &= test::verifyResult(testExportFence);
+    test::printHeader("Testing fence import");
+    result &= test::verifyResult(testImportFence);
+    test::printHeader("Testing event loop wait w/poll");
+    result &= test::verifyResult(boost::bind(testEventLoopWait, WaitPoll));
+    test::printHeader("Testing event loop wait w/epoll");
+    result &= test::verifyResult(boost::bind(testEventLoopWait, WaitEpoll));
+    test::printHeader("Testing event loop wait w/waiter thread");
+    result &= test::verifyResult(boost::bind(testEventLoopWait, WaitThread));
+
+out:
+    util::destroyProgram(program);
+    util::destroyWindow();
+
+    printf("================================================\n");
+    printf("Result: ");
+    test::printResult(result);
+
+    return result ? 0 : 1;
+}
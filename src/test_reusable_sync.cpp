@@ -0,0 +1,649 @@
+/**
+ * EGL_KHR_reusable_sync test
+ * Copyright (C) 2010 Nokia
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * \author Sami Kyöstilä <sami.kyostila@nokia.com>
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include "ext.h"
+#include "native.h"
+#include "util.h"
+#include "testutil.h"
+
+static PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
+static PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
+static PFNEGLCLIENTWAITSYNCKHRPROC eglClientWaitSyncKHR;
+static PFNEGLSIGNALSYNCKHRPROC eglSignalSyncKHR;
+static PFNEGLGETSYNCATTRIBKHRPROC eglGetSyncAttribKHR;
+
+/** Number of round trips in the ping-pong benchmarks */
+static const int rounds = 2048;
+
+/**
+ * Verify that the needed extensions are present
+ */
+void testExtensionPresence()
+{
+    ASSERT(util::isEGLExtensionSupported("EGL_KHR_reusable_sync"));
+
+    eglCreateSyncKHR =
+        (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    eglDestroySyncKHR =
+        (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    eglClientWaitSyncKHR =
+        (PFNEGLCLIENTWAITSYNCKHRPROC)eglGetProcAddress("eglClientWaitSyncKHR");
+    eglSignalSyncKHR =
+        (PFNEGLSIGNALSYNCKHRPROC)eglGetProcAddress("eglSignalSyncKHR");
+    eglGetSyncAttribKHR =
+        (PFNEGLGETSYNCATTRIBKHRPROC)eglGetProcAddress("eglGetSyncAttribKHR");
+
+    ASSERT(eglCreateSyncKHR);
+    ASSERT(eglDestroySyncKHR);
+    ASSERT(eglClientWaitSyncKHR);
+    ASSERT(eglSignalSyncKHR);
+    ASSERT(eglGetSyncAttribKHR);
+}
+
+/**
+ *  @returns the value of a sync object attribute
+ */
+static EGLint getSyncAttrib(EGLSyncKHR sync, EGLint attribute)
+{
+    EGLint value = 0;
+    EGLBoolean success = eglGetSyncAttribKHR(util::ctx.dpy, sync, attribute, &value);
+    ASSERT_EGL();
+    ASSERT(success);
+    return value;
+}
+
+/**
+ *  Test known invalid inputs.
+ *
+ *  1. Create a reusable sync with an unknown attribute.
+ *  2. Signal a sync with an invalid mode.
+ *  3. Signal and wait on an invalid sync object.
+ */
+void testFailureCases()
+{
+    const EGLint badAttrs[] =
+    {
+        EGL_SYNC_STATUS_KHR, EGL_SIGNALED_KHR,
+        EGL_NONE
+    };
+
+    EGLSyncKHR sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_REUSABLE_KHR, badAttrs);
+    ASSERT(sync == EGL_NO_SYNC_KHR);
+    ASSERT(eglGetError() == EGL_BAD_ATTRIBUTE);
+
+    sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_REUSABLE_KHR, NULL);
+    ASSERT_EGL();
+    ASSERT(sync != EGL_NO_SYNC_KHR);
+
+    ASSERT(!eglSignalSyncKHR(util::ctx.dpy, sync, EGL_SYNC_REUSABLE_KHR));
+    ASSERT(eglGetError() == EGL_BAD_ATTRIBUTE);
+
+    eglDestroySyncKHR(util::ctx.dpy, sync);
+    ASSERT_EGL();
+
+    ASSERT(!eglSignalSyncKHR(util::ctx.dpy, EGL_NO_SYNC_KHR, EGL_SIGNALED_KHR));
+    ASSERT(eglGetError() == EGL_BAD_PARAMETER);
+
+    ASSERT(eglClientWaitSyncKHR(util::ctx.dpy, EGL_NO_SYNC_KHR, 0, 0) == EGL_FALSE);
+    ASSERT(eglGetError() == EGL_BAD_PARAMETER);
+}
+
+/**
+ *  Test the state transitions of a reusable sync in a single thread.
+ *
+ *  1. Create a reusable sync and check that it is unsignaled.
+ *  2. Check that a wait with a zero timeout expires.
+ *  3. Signal the sync and check that waiting succeeds, repeatedly.
+ *  4. Unsignal the sync and check that a wait times out again.
+ */
+void testStateTransitions()
+{
+    EGLSyncKHR sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_REUSABLE_KHR, NULL);
+    ASSERT_EGL();
+
+    ASSERT(getSyncAttrib(sync, EGL_SYNC_TYPE_KHR) == EGL_SYNC_REUSABLE_KHR);
+    ASSERT(getSyncAttrib(sync, EGL_SYNC_STATUS_KHR) == EGL_UNSIGNALED_KHR);
+    ASSERT(eglClientWaitSyncKHR(util::ctx.dpy, sync, 0, 0) == EGL_TIMEOUT_EXPIRED_KHR);
+
+    for (int i = 0; i < 4; i++)
+    {
+        eglSignalSyncKHR(util::ctx.dpy, sync, EGL_SIGNALED_KHR);
+        ASSERT_EGL();
+        ASSERT(getSyncAttrib(sync, EGL_SYNC_STATUS_KHR) == EGL_SIGNALED_KHR);
+        ASSERT(eglClientWaitSyncKHR(util::ctx.dpy, sync, 0, EGL_FOREVER_KHR) ==
+               EGL_CONDITION_SATISFIED_KHR);
+
+        eglSignalSyncKHR(util::ctx.dpy, sync, EGL_UNSIGNALED_KHR);
+        ASSERT_EGL();
+        ASSERT(getSyncAttrib(sync, EGL_SYNC_STATUS_KHR) == EGL_UNSIGNALED_KHR);
+        ASSERT(eglClientWaitSyncKHR(util::ctx.dpy, sync, 0, 0) == EGL_TIMEOUT_EXPIRED_KHR);
+    }
+
+    eglDestroySyncKHR(util::ctx.dpy, sync);
+    ASSERT_EGL();
+}
+
+/**
+ *  Test that a wait on an unsignaled sync lasts for at least the timeout.
+ */
+void testTimeout()
+{
+    const EGLTimeKHR timeout = 20ull * 1000 * 1000;
+
+    EGLSyncKHR sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_REUSABLE_KHR, NULL);
+    ASSERT_EGL();
+
+    int64_t start = util::getTime();
+    EGLint ret = eglClientWaitSyncKHR(util::ctx.dpy, sync, 0, timeout);
+    int64_t time = util::getTime() - start;
+
+    eglDestroySyncKHR(util::ctx.dpy, sync);
+    ASSERT_EGL();
+    ASSERT(ret == EGL_TIMEOUT_EXPIRED_KHR);
+    ASSERT(time >= (int64_t)timeout);
+}
+
+/** Waiting thread of the cross-thread signal test */
+struct WaiterContext
+{
+    EGLSyncKHR sync;
+    EGLint result;
+    int64_t wakeTime;
+};
+
+void* waiterThread(void* data)
+{
+    WaiterContext* ctx = reinterpret_cast<WaiterContext*>(data);
+
+    ctx->result = eglClientWaitSyncKHR(util::ctx.dpy, ctx->sync, 0, EGL_FOREVER_KHR);
+    ctx->wakeTime = util::getTime();
+    return NULL;
+}
+
+/**
+ *  Test signaling a sync object from another thread.
+ *
+ *  1. Start a thread waiting on an unsignaled reusable sync.
+ *  2. Sleep for a while in the main thread and signal the sync.
+ *  3. Check that the thread woke up only after the signal.
+ */
+void testCrossThreadSignal()
+{
+    WaiterContext ctx;
+    pthread_t thread;
+
+    ctx.sync = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_REUSABLE_KHR, NULL);
+    ctx.result = EGL_FALSE;
+    ctx.wakeTime = 0;
+    ASSERT_EGL();
+
+    pthread_create(&thread, NULL, waiterThread, &ctx);
+    usleep(20 * 1000);
+
+    int64_t signalTime = util::getTime();
+    eglSignalSyncKHR(util::ctx.dpy, ctx.sync, EGL_SIGNALED_KHR);
+    pthread_join(thread, NULL);
+
+    eglDestroySyncKHR(util::ctx.dpy, ctx.sync);
+    ASSERT_EGL();
+    ASSERT(ctx.result == EGL_CONDITION_SATISFIED_KHR);
+    ASSERT(ctx.wakeTime >= signalTime);
+}
+
+/**
+ *  Test recycling reusable syncs through a pool.
+ *
+ *  1. Create a pool of two syncs and acquire three, growing the pool.
+ *  2. Signal the syncs and release them back to the pool.
+ *  3. Acquire the syncs again and check that they are unsignaled.
+ */
+void testSyncPool()
+{
+    util::SyncPool pool(util::ctx.dpy, 2);
+    EGLSyncKHR sync[3];
+
+    ASSERT(pool.size() == 2);
+    for (int i = 0; i < 3; i++)
+    {
+        sync[i] = pool.acquire();
+        ASSERT(sync[i] != EGL_NO_SYNC_KHR);
+        ASSERT(getSyncAttrib(sync[i], EGL_SYNC_TYPE_KHR) == EGL_SYNC_REUSABLE_KHR);
+    }
+    ASSERT(pool.size() == 3);
+
+    for (int i = 0; i < 3; i++)
+    {
+        eglSignalSyncKHR(util::ctx.dpy, sync[i], EGL_SIGNALED_KHR);
+        pool.release(sync[i]);
+    }
+
+    for (int i = 0; i < 3; i++)
+    {
+        sync[i] = pool.acquire();
+        ASSERT(getSyncAttrib(sync[i], EGL_SYNC_STATUS_KHR) == EGL_UNSIGNALED_KHR);
+    }
+    ASSERT(pool.size() == 3);
+
+    for (int i = 0; i < 3; i++)
+    {
+        pool.release(sync[i]);
+    }
+    ASSERT_EGL();
+}
+
+/** Ways of obtaining a sync object for every frame */
+enum SyncSource
+{
+    SyncPooled,         /** Reusable sync recycled through a util::SyncPool */
+    SyncReusable,       /** Reusable sync created and destroyed every time */
+    SyncFence           /** Fence sync created and destroyed every time */
+};
+
+/**
+ *  Measure the per-use overhead of sync objects with and without recycling.
+ *
+ *  Test loop:
+ *
+ *  1. Obtain a sync according to @source.
+ *  2. Signal it (reusable syncs) or let the empty command stream signal it
+ *     (fence syncs) and wait for it with eglClientWaitSyncKHR.
+ *  3. Release the sync to the pool or destroy it.
+ *
+ *  The test results are the average time spent obtaining, waiting for and
+ *  releasing a sync object.
+ */
+void testSyncRecycling(SyncSource source)
+{
+    const int cycles = 4096;
+    util::SyncPool pool(util::ctx.dpy, source == SyncPooled ? 4 : 0);
+    int64_t start, totalObtain = 0, totalWait = 0, totalRelease = 0;
+
+    for (int i = 0; i < cycles; i++)
+    {
+        EGLSyncKHR sync;
+
+        start = util::getTime();
+        if (source == SyncPooled)
+        {
+            sync = pool.acquire();
+        }
+        else
+        {
+            sync = eglCreateSyncKHR(util::ctx.dpy, source == SyncFence ?
+                                    EGL_SYNC_FENCE_KHR : EGL_SYNC_REUSABLE_KHR, NULL);
+        }
+        totalObtain += util::getTime() - start;
+        ASSERT(sync != EGL_NO_SYNC_KHR);
+
+        start = util::getTime();
+        if (source != SyncFence)
+        {
+            eglSignalSyncKHR(util::ctx.dpy, sync, EGL_SIGNALED_KHR);
+        }
+        EGLint ret = eglClientWaitSyncKHR(util::ctx.dpy, sync,
+                EGL_SYNC_FLUSH_COMMANDS_BIT_KHR, 1000ull * 1000 * 1000);
+        totalWait += util::getTime() - start;
+        ASSERT(ret == EGL_CONDITION_SATISFIED_KHR);
+
+        start = util::getTime();
+        if (source == SyncPooled)
+        {
+            pool.release(sync);
+        }
+        else
+        {
+            eglDestroySyncKHR(util::ctx.dpy, sync);
+        }
+        totalRelease += util::getTime() - start;
+    }
+    ASSERT_EGL();
+    ASSERT(pool.size() == (source == SyncPooled ? 4u : 0u));
+
+    printf("%.2f us / %.2f us / %.2f us : ",
+            totalObtain / 1000.0 / cycles,
+            totalWait / 1000.0 / cycles,
+            totalRelease / 1000.0 / cycles);
+}
+
+/**
+ *  A pair of one-shot events used to bounce control between two threads
+ */
+class PingPongChannel
+{
+public:
+    virtual ~PingPongChannel() {}
+
+    /** Signal event @event */
+    virtual void signal(int event) = 0;
+
+    /** Wait until event @event is signaled */
+    virtual void wait(int event) = 0;
+
+    /** Return event @event to the unsignaled state */
+    virtual void reset(int event) = 0;
+};
+
+/** Events implemented with reusable sync objects */
+class SyncChannel: public PingPongChannel
+{
+public:
+    SyncChannel()
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            m_sync[i] = eglCreateSyncKHR(util::ctx.dpy, EGL_SYNC_REUSABLE_KHR, NULL);
+            ASSERT(m_sync[i] != EGL_NO_SYNC_KHR);
+        }
+    }
+
+    ~SyncChannel()
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            eglDestroySyncKHR(util::ctx.dpy, m_sync[i]);
+        }
+    }
+
+    void signal(int event)
+    {
+        eglSignalSyncKHR(util::ctx.dpy, m_sync[event], EGL_SIGNALED_KHR);
+    }
+
+    void wait(int event)
+    {
+        eglClientWaitSyncKHR(util::ctx.dpy, m_sync[event], 0, EGL_FOREVER_KHR);
+    }
+
+    void reset(int event)
+    {
+        eglSignalSyncKHR(util::ctx.dpy, m_sync[event], EGL_UNSIGNALED_KHR);
+    }
+
+private:
+    EGLSyncKHR m_sync[2];
+};
+
+/** Events implemented with a mutex and a condition variable */
+class ConditionChannel: public PingPongChannel
+{
+public:
+    ConditionChannel()
+    {
+        pthread_mutex_init(&m_lock, NULL);
+        pthread_cond_init(&m_changed, NULL);
+        m_signaled[0] = m_signaled[1] = false;
+    }
+
+    ~ConditionChannel()
+    {
+        pthread_cond_destroy(&m_changed);
+        pthread_mutex_destroy(&m_lock);
+    }
+
+    void signal(int event)
+    {
+        pthread_mutex_lock(&m_lock);
+        m_signaled[event] = true;
+        pthread_cond_broadcast(&m_changed);
+        pthread_mutex_unlock(&m_lock);
+    }
+
+    void wait(int event)
+    {
+        pthread_mutex_lock(&m_lock);
+        while (!m_signaled[event])
+        {
+            pthread_cond_wait(&m_changed, &m_lock);
+        }
+        pthread_mutex_unlock(&m_lock);
+    }
+
+    void reset(int event)
+    {
+        pthread_mutex_lock(&m_lock);
+        m_signaled[event] = false;
+        pthread_mutex_unlock(&m_lock);
+    }
+
+private:
+    pthread_mutex_t m_lock;
+    pthread_cond_t m_changed;
+    bool m_signaled[2];
+};
+
+/** Events implemented directly with futexes */
+class FutexChannel: public PingPongChannel
+{
+public:
+    FutexChannel()
+    {
+        m_word[0] = m_word[1] = 0;
+    }
+
+    void signal(int event)
+    {
+        __sync_lock_test_and_set(&m_word[event], 1);
+        syscall(SYS_futex, &m_word[event], FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+
+    void wait(int event)
+    {
+        while (!__sync_fetch_and_add(&m_word[event], 0))
+        {
+            syscall(SYS_futex, &m_word[event], FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+        }
+    }
+
+    void reset(int event)
+    {
+        __sync_lock_test_and_set(&m_word[event], 0);
+    }
+
+private:
+    volatile int m_word[2];
+};
+
+/** State shared by the ping-pong benchmark threads */
+struct PingPongContext
+{
+    PingPongChannel* channel;
+    int64_t sendTime;                   /** Time of the latest ping */
+    util::Samples latency;              /** Ping to wakeup times */
+};
+
+/**
+ *  Responding thread of the ping-pong benchmark
+ */
+void* pongThread(void* data)
+{
+    PingPongContext* ctx = reinterpret_cast<PingPongContext*>(data);
+
+    for (int i = 0; i < rounds; i++)
+    {
+        ctx->channel->wait(0);
+        ctx->latency.add(util::getTime() - ctx->sendTime);
+        ctx->channel->reset(0);
+        ctx->channel->signal(1);
+    }
+    return NULL;
+}
+
+/** Signaling primitives compared by the ping-pong benchmark */
+enum PingPongPrimitive
+{
+    PingPongSync,       /** Reusable syncs, see SyncChannel */
+    PingPongCondition,  /** A pthread condition variable, see ConditionChannel */
+    PingPongFutex       /** Futexes, see FutexChannel */
+};
+
+/**
+ *  Measure the wakeup latency of a signaling primitive.
+ *
+ *  Initialization:
+ *
+ *  1. Create a pair of events implemented with @primitive.
+ *  2. Start a responding thread.
+ *
+ *  Test loop:
+ *
+ *  1. Signal the first event in the main thread and wait for the second.
+ *  2. In the responding thread, wake up on the first event, reset it and
+ *     signal the second.
+ *  3. In the main thread, reset the second event.
+ *
+ *  The test results are the average, median, 99th percentile and worst time
+ *  from signaling the first event to the responding thread waking up, and the
+ *  average round trip time.
+ */
+void testPingPongLatency(PingPongPrimitive primitive)
+{
+    PingPongContext ctx;
+    pthread_t thread;
+
+    switch (primitive)
+    {
+    case PingPongSync:
+        ctx.channel = new SyncChannel();
+        break;
+    case PingPongCondition:
+        ctx.channel = new ConditionChannel();
+        break;
+    case PingPongFutex:
+        ctx.channel = new FutexChannel();
+        break;
+    }
+    ctx.sendTime = 0;
+
+    pthread_create(&thread, NULL, pongThread, &ctx);
+
+    int64_t start = util::getTime();
+    for (int i = 0; i < rounds; i++)
+    {
+        ctx.sendTime = util::getTime();
+        ctx.channel->signal(0);
+        ctx.channel->wait(1);
+        ctx.channel->reset(1);
+    }
+    int64_t time = util::getTime() - start;
+
+    pthread_join(thread, NULL);
+    delete ctx.channel;
+    ASSERT_EGL();
+
+    printf("%.1f us / %.1f us / %.1f us / %.1f us, %.1f us round trip : ",
+           ctx.latency.mean() / 1000.0,
+           ctx.latency.percentile(50) / 1000.0,
+           ctx.latency.percentile(99) / 1000.0,
+           ctx.latency.max() / 1000.0,
+           time / 1000.0 / rounds);
+}
+
+int main(int argc, char** argv)
+{
+    bool result;
+    int winWidth = 864;
+    int winHeight = 480;
+    int winDepth = 16;
+
+    const char* eglExtensions[] = {"EGL_KHR_reusable_sync", NULL};
+
+    if (test::skipUnsupported(eglExtensions, NULL))
+    {
+        return 1;
+    }
+
+    EGLNativeDisplayType dpy;
+    nativeCreateDisplay(&dpy);
+    nativeGetDisplayProperties(dpy, &winWidth, &winHeight, &winDepth);
+    nativeDestroyDisplay(dpy);
+
+    const EGLint configAttrs[] =
+    {
+        EGL_BUFFER_SIZE,     winDepth,
+        EGL_SURFACE_TYPE,    EGL_WINDOW_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE
+    };
+
+    const EGLint contextAttrs[] =
+    {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+
+    result = util::createWindow(winWidth, winHeight, configAttrs, contextAttrs);
+    ASSERT(result);
+    ASSERT_EGL();
+
+    test::printHeader("Testing extension presence");
+    result = test::verifyResult(testExtensionPresence);
+
+    if (!result)
+    {
+        goto out;
+    }
+
+    test::printHeader("Testing failure cases");
+    result &= test::verifyResult(testFailureCases);
+    test::printHeader("Testing state transitions");
+    result &= test::verifyResult(testStateTransitions);
+    test::printHeader("Testing wait timeout");
+    result &= test::verifyResult(testTimeout);
+    test::printHeader("Testing cross-thread signaling");
+    result &= test::verifyResult(testCrossThreadSignal);
+    test::printHeader("Testing sync pool");
+    result &= test::verifyResult(testSyncPool);
+    test::printHeader("Testing pooled reusable syncs");
+    result &= test::verifyResult(boost::bind(testSyncRecycling, SyncPooled));
+    test::printHeader("Testing created reusable syncs");
+    result &= test::verifyResult(boost::bind(testSyncRecycling, SyncReusable));
+    if (util::isEGLExtensionSupported("EGL_KHR_fence_sync"))
+    {
+        test::printHeader("Testing created fence syncs");
+        result &= test::verifyResult(boost::bind(testSyncRecycling, SyncFence));
+    }
+    test::printHeader("Testing reusable sync ping-pong latency");
+    result &= test::verifyResult(boost::bind(testPingPongLatency, PingPongSync));
+    test::printHeader("Testing condition variable ping-pong latency");
+    result &= test::verifyResult(boost::bind(testPingPongLatency, PingPongCondition));
+    test::printHeader("Testing futex ping-pong latency");
+    result &= test::verifyResult(boost::bind(testPingPongLatency, PingPongFutex));
+
+out:
+    util::destroyWindow();
+
+    printf("================================================\n");
+    printf("Result: ");
+    test::printResult(result);
+
+    return result ? 0 : 1;
+}
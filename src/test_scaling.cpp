@@ -869,17 +869,22 @@ void testRendering()
     ASSERT_EGL();
 
     GLint program = util::createProgram(test::color::vertSource, test::color::fragSource);
-    glUseProgram(program);
+    test::useProgram(program);
 
-    for(i = 0 ; i < winWidth / 4; ++i)
+    /* Draw all pixels in one batch */
     {
-        GLfloat r = (i & 1) ? 1.0f : 0.0f;
-        GLfloat g = (i & 1) ? 1.0f : 0.0f;
-        GLfloat b = (i & 1) ? 1.0f : 0.0f;
-        test::color::drawQuad(i, i, 1, 1, r, g, b);
-        test::color::drawQuad(winWidth - 1 - i, i, 1, 1, r, g, b);
-        test::color::drawQuad(i, winHeight - 1 - i, 1, 1, r, g, b);
-        test::color::drawQuad(winWidth - 1 - i, winHeight - 1 - i, 1, 1, r, g, b);
+        test::QuadBatch batch;
+        for(i = 0 ; i < winWidth / 4; ++i)
+        {
+            GLfloat r = (i & 1) ? 1.0f : 0.0f;
+            GLfloat g = (i & 1) ? 1.0f : 0.0f;
+            GLfloat b = (i & 1) ? 1.0f : 0.0f;
+            batch.add(i, i, 1, 1, r, g, b);
+            batch.add(winWidth - 1 - i, i, 1, 1, r, g, b);
+            batch.add(i, winHeight - 1 - i, 1, 1, r, g, b);
+            batch.add(winWidth - 1 - i, winHeight - 1 - i, 1, 1, r, g, b);
+        }
+        batch.flush();
     }
 
     for(i = 0 ; i < winWidth / 4; ++i)
@@ -923,7 +928,7 @@ void testRendering()
     eglSwapBuffers(util::ctx.dpy, surface);
     ASSERT_EGL();
 
-    glDeleteProgram(program);
+    util::destroyProgram(program);
     eglMakeCurrent(util::ctx.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     eglDestroySurface(util::ctx.dpy, surface);
     surface = 0;
@@ -985,6 +990,7 @@ bool initWindow()
     return true;
 
   out_error:
+    util::forgetPrograms(util::ctx.context);
     eglDestroyContext(util::ctx.dpy, util::ctx.context);
     eglTerminate(util::ctx.dpy);
     nativeDestroyWindow(util::ctx.nativeDisplay, util::ctx.win);
@@ -997,6 +1003,8 @@ bool initWindow()
  */
 void deinitWindow()
 {
+    test::resetRenderState();
+    util::forgetPrograms(util::ctx.context);
     eglDestroyContext(util::ctx.dpy, util::ctx.context);
     eglTerminate(util::ctx.dpy);
     nativeDestroyWindow(util::ctx.nativeDisplay, util::ctx.win);
@@ -1005,6 +1013,13 @@ void deinitWindow()
 
 int main(int argc, char** argv)
 {
+    const char* eglExtensions[] = {"EGL_NOK_surface_scaling", NULL};
+
+    if (test::skipUnsupported(eglExtensions, NULL))
+    {
+        return 1;
+    }
+
     EGLNativeDisplayType dpy;
     nativeCreateDisplay(&dpy);
     nativeGetDisplayProperties(dpy, &winWidth, &winHeight, &winDepth);
@@ -0,0 +1,475 @@
+/**
+ * Shader compile and link latency test
+ * Copyright (C) 2010 Nokia
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * \author Sami Kyöstilä <sami.kyostila@nokia.com>
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ext.h"
+#include "native.h"
+#include "util.h"
+#include "testutil.h"
+
+static PFNGLGETPROGRAMBINARYOESPROC glGetProgramBinaryOES;
+static PFNGLPROGRAMBINARYOESPROC glProgramBinaryOES;
+
+/** Number of programs to build for each measurement */
+static const int cycles = 8;
+
+/** Counter used to make every cold shader source unique */
+static unsigned int saltCounter;
+
+/**
+ * Verify that program binaries can be retrieved and reloaded
+ */
+void testExtensionPresence()
+{
+    GLint formatCount = 0;
+
+    ASSERT(util::isGLExtensionSupported("GL_OES_get_program_binary"));
+
+    glGetProgramBinaryOES =
+        (PFNGLGETPROGRAMBINARYOESPROC)eglGetProcAddress("glGetProgramBinaryOES");
+    glProgramBinaryOES =
+        (PFNGLPROGRAMBINARYOESPROC)eglGetProcAddress("glProgramBinaryOES");
+
+    ASSERT(glGetProgramBinaryOES);
+    ASSERT(glProgramBinaryOES);
+
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formatCount);
+    ASSERT(formatCount > 0);
+}
+
+/**
+ *  Time spent in each stage of building and using a program
+ */
+struct Timings
+{
+    int64_t compile;
+    int64_t link;
+    int64_t firstDraw;
+    int64_t secondDraw;
+    int64_t worst;
+
+    Timings():
+        compile(0),
+        link(0),
+        firstDraw(0),
+        secondDraw(0),
+        worst(0)
+    {
+    }
+
+    /**
+     *  Print the average stage times and the slowest total time to first
+     *  frame
+     */
+    void print() const
+    {
+        printf("%lld us compile, %lld us link, %lld us first draw, %lld us second draw, "
+               "%lld us worst : ",
+               (long long)(compile / cycles / 1000),
+               (long long)(link / cycles / 1000),
+               (long long)(firstDraw / cycles / 1000),
+               (long long)(secondDraw / cycles / 1000),
+               (long long)(worst / 1000));
+    }
+};
+
+/**
+ *  Generate a vertex shader
+ *
+ *  @param salt                 Constant embedded in the source so that the
+ *                              driver can not find it in its own caches
+ */
+static std::string vertexShader(unsigned int salt)
+{
+    char source[512];
+
+    snprintf(source, sizeof(source),
+        "precision mediump float;\n"
+        "attribute vec2 in_position;\n"
+        "attribute vec2 in_texcoord;\n"
+        "varying vec2 texcoord;\n"
+        "const float salt = %u.0;\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "   gl_Position = vec4(in_position, 0.0, 1.0);\n"
+        "   texcoord = in_texcoord + vec2(salt * 1e-20);\n"
+        "}\n", salt);
+    return source;
+}
+
+/**
+ *  Generate a fragment shader with @complexity unrolled blocks of arithmetic,
+ *  every fourth of which also samples a texture
+ *
+ *  @param complexity           Number of blocks to generate
+ *  @param salt                 Constant embedded in the source so that the
+ *                              driver can not find it in its own caches
+ */
+static std::string fragmentShader(int complexity, unsigned int salt)
+{
+    char line[256];
+    std::string source =
+        "precision mediump float;\n"
+        "varying vec2 texcoord;\n"
+        "uniform sampler2D texture;\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "   vec4 color = texture2D(texture, texcoord);\n";
+
+    for (int i = 0; i < complexity; i++)
+    {
+        float k = (i % 7 + 1) / 8.0f;
+
+        if (i % 4 == 3)
+        {
+            snprintf(line, sizeof(line),
+                "   color = mix(color, texture2D(texture, texcoord + vec2(%f, %f)), %f);\n",
+                k / 64.0f, -k / 64.0f, k);
+        }
+        else
+        {
+            snprintf(line, sizeof(line),
+                "   color = fract(color * vec4(%f, %f, %f, 1.0) + sin(color.yzwx * %f));\n",
+                k, 1.0f - k, k * k, k + 1.0f);
+        }
+        source += line;
+    }
+
+    snprintf(line, sizeof(line),
+        "   gl_FragColor = color + vec4(%u.0 * 1e-20);\n"
+        "}\n", salt);
+    return source + line;
+}
+
+/**
+ *  Compile a shader and wait for the result
+ */
+static GLuint compileShader(GLenum type, const std::string& source)
+{
+    const char* src = source.c_str();
+    GLint success = 0;
+
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &src, 0);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    ASSERT(success);
+    return shader;
+}
+
+/**
+ *  Draw a small quad with @program and read back a pixel to make sure any
+ *  compilation deferred to the first draw has completed
+ *
+ *  @returns the time taken in nanoseconds
+ */
+static int64_t timeDraw(GLuint program)
+{
+    uint8_t color[4];
+    int64_t start = util::getTime();
+
+    test::useProgram(program);
+    test::drawQuad(0, 0, 8, 8);
+    glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, color);
+
+    return util::getTime() - start;
+}
+
+/**
+ *  Draw with a freshly created program twice, add the times to @timings and
+ *  delete the program
+ */
+static void drawAndDelete(GLuint program, int64_t buildTime, Timings& timings)
+{
+    int64_t firstDraw = timeDraw(program);
+    int64_t secondDraw = timeDraw(program);
+
+    timings.firstDraw += firstDraw;
+    timings.secondDraw += secondDraw;
+    timings.worst = std::max(timings.worst, buildTime + firstDraw);
+
+    test::useProgram(0);
+    glDeleteProgram(program);
+    ASSERT_GL();
+}
+
+/**
+ *  Create a texture for the generated fragment shaders to sample
+ */
+static GLuint createTexture()
+{
+    GLuint texture;
+    std::vector<uint8_t> data;
+    const uint8_t color[] = {0x00, 0x00, 0xff, 0xff};
+
+    bool generated = util::generateTexture(GL_RGBA, GL_UNSIGNED_BYTE, 64, 64, color, data);
+    ASSERT(generated);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 64, 64, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    ASSERT_GL();
+    return texture;
+}
+
+/**
+ *  Measure the latency of building a program from source.
+ *
+ *  Initialization:
+ *
+ *  1. If @cold is false, build the program once so that the driver may
+ *     cache it.
+ *
+ *  Test loop:
+ *
+ *  1. Compile a vertex shader and a fragment shader with @complexity blocks
+ *     of code. In the cold case the sources are made unique for each cycle.
+ *  2. Link them into a program.
+ *  3. Draw a quad with the program twice, reading back a pixel each time.
+ *  4. Delete the program.
+ *
+ *  The test result is the average time of each stage and the worst total
+ *  time from compilation to the end of the first draw.
+ */
+void testCompileLatency(int complexity, bool cold)
+{
+    Timings timings;
+    GLuint texture = createTexture();
+    unsigned int salt = (unsigned int)(util::getTime() / 1000) + saltCounter++;
+
+    for (int i = cold ? 0 : -1; i < cycles; i++)
+    {
+        if (cold)
+        {
+            salt++;
+            saltCounter++;
+        }
+
+        std::string vertSrc = vertexShader(salt);
+        std::string fragSrc = fragmentShader(complexity, salt);
+
+        int64_t start = util::getTime();
+        GLuint vertShader = compileShader(GL_VERTEX_SHADER, vertSrc);
+        GLuint fragShader = compileShader(GL_FRAGMENT_SHADER, fragSrc);
+        int64_t compileTime = util::getTime() - start;
+
+        start = util::getTime();
+        GLint success = 0;
+        GLuint program = glCreateProgram();
+        glAttachShader(program, vertShader);
+        glAttachShader(program, fragShader);
+        glLinkProgram(program);
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        int64_t linkTime = util::getTime() - start;
+        ASSERT(success);
+
+        glDeleteShader(vertShader);
+        glDeleteShader(fragShader);
+
+        /* The warm-up build is not measured */
+        if (i < 0)
+        {
+            Timings warmup;
+            drawAndDelete(program, 0, warmup);
+            continue;
+        }
+
+        timings.compile += compileTime;
+        timings.link += linkTime;
+        drawAndDelete(program, compileTime + linkTime, timings);
+    }
+
+    timings.print();
+    glDeleteTextures(1, &texture);
+}
+
+/**
+ *  Measure the latency of building a program from a program binary.
+ *
+ *  Initialization:
+ *
+ *  1. Build a program with @complexity blocks of code from unique sources.
+ *  2. Retrieve its binary with glGetProgramBinaryOES and delete it.
+ *
+ *  Test loop:
+ *
+ *  1. Create a program from the binary with glProgramBinaryOES.
+ *  2. Draw a quad with the program twice, reading back a pixel each time.
+ *  3. Delete the program.
+ *
+ *  The test result is the average time of each stage and the worst total
+ *  time from loading to the end of the first draw. The load time is reported
+ *  as link time.
+ */
+void testBinaryReloadLatency(int complexity)
+{
+    Timings timings;
+    GLuint texture = createTexture();
+    unsigned int salt = (unsigned int)(util::getTime() / 1000) + saltCounter++;
+    GLint success = 0;
+
+    GLuint vertShader = compileShader(GL_VERTEX_SHADER, vertexShader(salt));
+    GLuint fragShader = compileShader(GL_FRAGMENT_SHADER, fragmentShader(complexity, salt));
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glAttachShader(program, fragShader);
+    glLinkProgram(program);
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    ASSERT(success);
+    glDeleteShader(vertShader);
+    glDeleteShader(fragShader);
+
+    GLint length = 0;
+    GLenum binaryFormat;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    ASSERT(length > 0);
+
+    std::vector<uint8_t> binary(length);
+    glGetProgramBinaryOES(program, length, &length, &binaryFormat, &binary[0]);
+    glDeleteProgram(program);
+    ASSERT_GL();
+
+    for (int i = 0; i < cycles; i++)
+    {
+        int64_t start = util::getTime();
+        program = glCreateProgram();
+        glProgramBinaryOES(program, binaryFormat, &binary[0], length);
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        int64_t loadTime = util::getTime() - start;
+        ASSERT(success);
+
+        timings.link += loadTime;
+        drawAndDelete(program, loadTime, timings);
+    }
+
+    timings.print();
+    glDeleteTextures(1, &texture);
+}
+
+/**
+ *  Measure the latency of util::createProgram() for a program that is
+ *  already cached.
+ *
+ *  Test loop:
+ *
+ *  1. Create a program from the test shaders with util::createProgram().
+ *  2. Release it with util::destroyProgram().
+ *
+ *  A reference to the program is held for the duration of the test. The test
+ *  result is the average time per cycle.
+ */
+void testCachedProgramLatency()
+{
+    GLint program = util::createProgram(test::vertSource, test::fragSource);
+    int cachedCycles = cycles * 64;
+
+    int64_t start = util::getTime();
+    for (int i = 0; i < cachedCycles; i++)
+    {
+        GLint cached = util::createProgram(test::vertSource, test::fragSource);
+        ASSERT(cached == program);
+        util::destroyProgram(cached);
+    }
+    int64_t time = util::getTime() - start;
+
+    printf("%.2f us / program : ", time / 1000.0 / cachedCycles);
+    util::destroyProgram(program);
+}
+
+int main(int argc, char** argv)
+{
+    bool result;
+    bool binarySupport;
+    int winWidth = 864;
+    int winHeight = 480;
+    int winDepth = 16;
+
+    EGLNativeDisplayType dpy;
+    nativeCreateDisplay(&dpy);
+    nativeGetDisplayProperties(dpy, &winWidth, &winHeight, &winDepth);
+    nativeDestroyDisplay(dpy);
+
+    const EGLint configAttrs[] =
+    {
+        EGL_BUFFER_SIZE,     winDepth,
+        EGL_SURFACE_TYPE,    EGL_WINDOW_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE
+    };
+
+    const EGLint contextAttrs[] =
+    {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+
+    result = util::createWindow(winWidth, winHeight, configAttrs, contextAttrs);
+    ASSERT(result);
+    ASSERT_EGL();
+
+    /* Number of generated code blocks in the fragment shader */
+    const int complexities[] = {0, 4, 16, 64};
+
+    test::printHeader("Testing extension presence");
+    binarySupport = test::verifyResult(testExtensionPresence);
+
+    for (unsigned int i = 0; i < sizeof(complexities) / sizeof(complexities[0]); i++)
+    {
+        int complexity = complexities[i];
+
+        test::printHeader("Testing cold program build (complexity %d)", complexity);
+        result &= test::verifyResult(boost::bind(testCompileLatency, complexity, true));
+
+        test::printHeader("Testing warm program build (complexity %d)", complexity);
+        result &= test::verifyResult(boost::bind(testCompileLatency, complexity, false));
+
+        if (binarySupport)
+        {
+            test::printHeader("Testing program binary reload (complexity %d)", complexity);
+            result &= test::verifyResult(boost::bind(testBinaryReloadLatency, complexity));
+        }
+    }
+
+    test::printHeader("Testing cached util::createProgram");
+    result &= test::verifyResult(testCachedProgramLatency);
+
+    util::destroyWindow();
+
+    printf("================================================\n");
+    printf("Result: ");
+    test::printResult(result);
+
+    return result ? 0 : 1;
+}
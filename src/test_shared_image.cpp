@@ -32,6 +32,9 @@
 
 #include <boost/scoped_array.hpp>
 
+#include <algorithm>
+#include <vector>
+
 #include "ext.h"
 #include "native.h"
 #include "util.h"
@@ -361,7 +364,7 @@ void testFramebuffers(GLint format, GLint type, int width, int height,
 
     /* Render the test pattern into the framebuffer */
     int b = 16;
-    glViewport(0, 0, width, height);
+    test::setViewport(0, 0, width, height);
     glClearColor(color[0] / 255.f, color[1] / 255.f, color[2] / 255.f, color[3] / 255.f);
     glClear(GL_COLOR_BUFFER_BIT);
     glScissor(b, b, width - 2 * b, height - 2 * b);
@@ -375,7 +378,7 @@ void testFramebuffers(GLint format, GLint type, int width, int height,
     glDisable(GL_SCISSOR_TEST);
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
-    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    test::setViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
     ASSERT_GL();
 
     /* Draw the filled texture */
@@ -454,6 +457,255 @@ void testFramebuffers(GLint format, GLint type, int width, int height,
     glDeleteTextures(1, &targetTexture2);
 }
 
+/**
+ *  Verify the test pattern of a texture drawn at (@x, @y) with @width x @height
+ *  dimensions.
+ */
+static void checkTestPattern(int x, int y, int width, int height,
+                             const uint8_t* color, const uint8_t* color2)
+{
+    ASSERT(test::checkColor(x + width / 2, y + height / 2, color2)); // center
+    ASSERT(test::checkColor(x + 4,         y + 4,          color2)); // lower left
+    ASSERT(test::checkColor(x + width / 2, y + 4,          color));  // lower middle
+    ASSERT(test::checkColor(x + width - 4, y + 4,          color2)); // lower right
+    ASSERT(test::checkColor(x + 4,         y + height - 4, color));  // upper left
+    ASSERT(test::checkColor(x + width / 2, y + height - 4, color));  // upper middle
+    ASSERT(test::checkColor(x + width - 4, y + height - 4, color));  // upper right
+}
+
+/**
+ *  Test shared images with generated textures of arbitrary size.
+ *
+ *  1. Create a texture of size @width x @height using @format and @type. If
+ *     @render is set, render the test pattern into the texture through a
+ *     framebuffer. Otherwise upload a generated test pattern.
+ *  2. Draw the texture scaled to 64x64 pixels and verify the test pattern.
+ *  3. Create an EGLImage from the texture.
+ *  4. Bind the EGLImage into a second texture.
+ *  5. Draw the second texture and verify the test pattern.
+ *  6. Clone the EGLImage into a shared image.
+ *  7. Create a second EGLImage from the shared image and verify its
+ *     properties.
+ *  8. Bind the second EGLImage into a third texture.
+ *  9. Draw the third texture and verify the test pattern.
+ */
+void testGeneratedTextures(GLint format, GLint type, int width, int height,
+                           const uint8_t* color, bool render)
+{
+    EGLImageKHR image1, image2;
+    GLuint sourceTexture, targetTexture1, targetTexture2;
+    test::scoped<EGLNativeSharedImageTypeNOK> sharedImage(
+            boost::bind(eglDestroySharedImageNOK, util::ctx.dpy, _1));
+    const int size = 64;
+    const int spacing = size + 32;
+    int offset = 0;
+    const uint8_t black[] = {0x00, 0x00, 0x00, 0xff};
+    const uint8_t white[] = {0xff, 0xff, 0xff, 0xff};
+    const uint8_t* color2 = (format == GL_ALPHA) ? black : white;
+
+    const EGLint imageAttributes[] =
+    {
+        EGL_IMAGE_PRESERVED_KHR, EGL_TRUE,
+        EGL_NONE
+    };
+
+    const EGLint sharedImageAttributes[] =
+    {
+        EGL_NONE
+    };
+
+    /* Create the texture */
+    glGenTextures(1, &sourceTexture);
+    glBindTexture(GL_TEXTURE_2D, sourceTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    if (render)
+    {
+        GLuint framebuffer;
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, type, NULL);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, sourceTexture, 0);
+        ASSERT_GL();
+
+        GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        if (status != GL_FRAMEBUFFER_COMPLETE)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glDeleteFramebuffers(1, &framebuffer);
+        }
+        ASSERT(status == GL_FRAMEBUFFER_COMPLETE);
+
+        /* Render the same pattern as util::generateTexture() */
+        int bx = width / 4, by = height / 4;
+        test::setViewport(0, 0, width, height);
+        glClearColor(color[0] / 255.f, color[1] / 255.f, color[2] / 255.f, color[3] / 255.f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glEnable(GL_SCISSOR_TEST);
+        glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+        glScissor(bx, by, width - 2 * bx, height - 2 * by);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glScissor(0, height - by, bx, by);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glScissor(width - bx, height - by, bx, by);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glDisable(GL_SCISSOR_TEST);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &framebuffer);
+        test::setViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    }
+    else
+    {
+        std::vector<uint8_t> pixels;
+        bool generated = util::generateTexture(format, type, width, height, color, pixels);
+        ASSERT(generated);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        if (format == GL_ETC1_RGB8_OES)
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0,
+                                   pixels.size(), &pixels[0]);
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, type, &pixels[0]);
+        }
+    }
+    ASSERT_GL();
+
+    /* Draw the texture */
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    test::drawQuad(offset, 0, size, size);
+    checkTestPattern(offset, 0, size, size, color, color2);
+
+    /* Create an EGL image from the texture */
+    image1 = eglCreateImageKHR(util::ctx.dpy, util::ctx.context, EGL_GL_TEXTURE_2D_KHR,
+                               (EGLClientBuffer)(intptr_t)sourceTexture, imageAttributes);
+    ASSERT_EGL();
+
+    /* Bind the image to a texture */
+    glGenTextures(1, &targetTexture1);
+    glBindTexture(GL_TEXTURE_2D, targetTexture1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image1);
+    ASSERT_GL();
+
+    offset += spacing;
+    test::drawQuad(offset, 0, size, size);
+    checkTestPattern(offset, 0, size, size, color, color2);
+
+    /* Clone the image into a shared image */
+    sharedImage = eglCreateSharedImageNOK(util::ctx.dpy, image1, sharedImageAttributes);
+    ASSERT_EGL();
+
+    /* Destroy the source texture and image */
+    eglDestroyImageKHR(util::ctx.dpy, image1);
+    glDeleteTextures(1, &sourceTexture);
+    glDeleteTextures(1, &targetTexture1);
+
+    /* Bind the shared image to an image */
+    image2 = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT,
+                               EGL_SHARED_IMAGE_NOK,
+                               (EGLClientBuffer)(intptr_t)sharedImage,
+                               imageAttributes);
+    ASSERT_EGL();
+
+    /* Verify the properties of the image */
+    EGLint imageWidth = 0, imageHeight = 0;
+    ASSERT(eglQueryImageNOK(util::ctx.dpy, image2, EGL_WIDTH, &imageWidth));
+    ASSERT(eglQueryImageNOK(util::ctx.dpy, image2, EGL_HEIGHT, &imageHeight));
+    ASSERT_EGL();
+    ASSERT(imageWidth == width);
+    ASSERT(imageHeight == height);
+
+    /* Bind the image to a texture */
+    glGenTextures(1, &targetTexture2);
+    glBindTexture(GL_TEXTURE_2D, targetTexture2);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image2);
+    ASSERT_GL();
+
+    offset += spacing;
+    test::drawQuad(offset, 0, size, size);
+    checkTestPattern(offset, 0, size, size, color, color2);
+
+    /* Clean up */
+    glDeleteTextures(1, &targetTexture2);
+    eglDestroyImageKHR(util::ctx.dpy, image2);
+}
+
+/**
+ *  Compare a generated texture against the shipped texture file it replaces.
+ *
+ *  1. Generate a texture of the asset's size with the asset's format.
+ *  2. For uncompressed formats, check that the data matches the base level of
+ *     the file byte for byte.
+ *  3. For ETC1, which is encoded differently from the tool that produced the
+ *     file, upload both, draw them unscaled and check that the decoded pixels
+ *     match within a small tolerance.
+ */
+void testGeneratedTextureMatchesAsset(const char* fileName, GLint format,
+                                      const uint8_t* color)
+{
+    const util::Asset* asset = util::findAsset(fileName);
+    ASSERT(asset);
+
+    std::vector<uint8_t> pixels;
+    bool generated = util::generateTexture(format, asset->type, asset->width,
+                                           asset->height, color, pixels);
+    ASSERT(generated);
+    ASSERT(pixels.size() <= asset->size);
+
+    if (format != GL_ETC1_RGB8_OES)
+    {
+        ASSERT(memcmp(&pixels[0], asset->data, pixels.size()) == 0);
+        return;
+    }
+
+    const int width = asset->width, height = asset->height;
+    const void* data[2] = {&pixels[0], asset->data};
+    boost::scoped_array<uint8_t> decoded[2];
+    GLuint textures[2];
+    const int tolerance = 4;
+
+    glGenTextures(2, textures);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    for (int i = 0; i < 2; i++)
+    {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glCompressedTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0,
+                               pixels.size(), data[i]);
+
+        glClear(GL_COLOR_BUFFER_BIT);
+        test::drawQuad(0, 0, width, height);
+
+        decoded[i].reset(new uint8_t[width * height * 4]);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &decoded[i][0]);
+    }
+    glDeleteTextures(2, textures);
+    ASSERT_GL();
+
+    for (int i = 0; i < width * height * 4; i++)
+    {
+        if (abs(decoded[0][i] - decoded[1][i]) > tolerance)
+        {
+            test::fail("Decoded texel (%d, %d) differs: %02x vs %02x\n",
+                       (i / 4) % width, (i / 4) / width, decoded[0][i], decoded[1][i]);
+        }
+    }
+}
+
 /**
  *  Measure the time needed to bind a shared image into a texture.
  *
@@ -566,6 +818,218 @@ void testMappingLatency(int width, int height)
     glDeleteTextures(1, &sourceTexture);
 }
 
+/**
+ *  Test EGLImages created from the mipmap levels of a texture.
+ *
+ *  1. Load a mipmapped texture from the KTX file @fileName. Each mipmap level
+ *     is filled with a solid color from @levelColors.
+ *  2. Draw each level at its native size using nearest mipmap filtering and
+ *     verify its color.
+ *  3. Create an EGLImage from each mipmap level.
+ *  4. Bind the EGLImage into a second texture.
+ *  5. Draw the second texture and verify the color of the level.
+ *  6. Clone the EGLImage of the base level into a shared image and verify its
+ *     properties.
+ */
+void testMipmappedTextures(const std::string& fileName, const uint8_t (*levelColors)[4],
+                           int levelCount)
+{
+    GLuint sourceTexture, targetTexture;
+    util::TextureInfo info;
+    test::scoped<EGLNativeSharedImageTypeNOK> sharedImage(
+            boost::bind(eglDestroySharedImageNOK, util::ctx.dpy, _1));
+
+    /* Load the texture */
+    glGenTextures(1, &sourceTexture);
+    glBindTexture(GL_TEXTURE_2D, sourceTexture);
+    bool texLoaded = util::loadKTXTexture(GL_TEXTURE_2D, fileName, &info);
+    ASSERT(texLoaded);
+    ASSERT(info.levels == levelCount);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    ASSERT_GL();
+
+    /* Draw each level at its native size */
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    int offset = 0;
+    for (int level = 0; level < levelCount; level++)
+    {
+        int width = std::max(info.width >> level, 1);
+        int height = std::max(info.height >> level, 1);
+
+        test::drawQuad(offset, 0, width, height);
+        ASSERT(test::checkColor(offset + width / 2, height / 2, levelColors[level]));
+        offset += width + 4;
+    }
+
+    /* Create an EGL image from each level and draw it */
+    glGenTextures(1, &targetTexture);
+
+    offset = 0;
+    for (int level = 0; level < levelCount; level++)
+    {
+        int width = std::max(info.width >> level, 1);
+        int height = std::max(info.height >> level, 1);
+
+        const EGLint imageAttributes[] =
+        {
+            EGL_GL_TEXTURE_LEVEL_KHR, level,
+            EGL_IMAGE_PRESERVED_KHR, EGL_TRUE,
+            EGL_NONE
+        };
+
+        EGLImageKHR image = eglCreateImageKHR(util::ctx.dpy, util::ctx.context,
+                                              EGL_GL_TEXTURE_2D_KHR,
+                                              (EGLClientBuffer)(intptr_t)sourceTexture,
+                                              imageAttributes);
+        ASSERT_EGL();
+
+        glBindTexture(GL_TEXTURE_2D, targetTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+        ASSERT_GL();
+
+        test::drawQuad(offset, info.height + 4, width, height);
+        ASSERT(test::checkColor(offset + width / 2, info.height + 4 + height / 2,
+                                levelColors[level]));
+        offset += width + 4;
+
+        /* Share the base level */
+        if (level == 0)
+        {
+            const EGLint sharedImageAttributes[] =
+            {
+                EGL_NONE
+            };
+            EGLint imageWidth = 0, imageHeight = 0;
+
+            sharedImage = eglCreateSharedImageNOK(util::ctx.dpy, image, sharedImageAttributes);
+            ASSERT_EGL();
+            ASSERT(eglQueryImageNOK(util::ctx.dpy, image, EGL_WIDTH, &imageWidth));
+            ASSERT(eglQueryImageNOK(util::ctx.dpy, image, EGL_HEIGHT, &imageHeight));
+            ASSERT(imageWidth == info.width);
+            ASSERT(imageHeight == info.height);
+        }
+
+        /* Detach the image before destroying it */
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        eglDestroyImageKHR(util::ctx.dpy, image);
+        ASSERT_EGL();
+    }
+
+    /* Clean up */
+    glDeleteTextures(1, &targetTexture);
+    glDeleteTextures(1, &sourceTexture);
+}
+
+/**
+ *  Measure the time needed to share a mipmapped texture.
+ *
+ *  Initialization:
+ *
+ *  1. Load a mipmapped texture from the KTX file @fileName.
+ *
+ *  Test loop:
+ *
+ *  1. Create an EGLImage from the base level of the texture.
+ *  2. Create a shared EGLImage from the EGLImage.
+ *  3. Bind the EGLImage into a texture.
+ *  4. Render the texture onto the screen and read back a single pixel to force
+ *     rendering to complete.
+ *
+ *  The test results contain the average timings of the listed test steps.
+ */
+void testMipmappedMappingLatency(const std::string& fileName)
+{
+    GLuint sourceTexture, targetTexture;
+    util::TextureInfo info;
+    int cycles = 64;
+    int64_t start, totalImageCreation = 0, totalSharedImageCreation = 0,
+            totalImageBinding = 0, totalRendering = 0;
+    uint8_t color[4];
+
+    const EGLint imageAttributes[] =
+    {
+        EGL_GL_TEXTURE_LEVEL_KHR, 0,
+        EGL_IMAGE_PRESERVED_KHR, EGL_TRUE,
+        EGL_NONE
+    };
+
+    const EGLint sharedImageAttributes[] =
+    {
+        EGL_NONE
+    };
+
+    /* Load the texture */
+    glGenTextures(1, &sourceTexture);
+    glBindTexture(GL_TEXTURE_2D, sourceTexture);
+    bool texLoaded = util::loadKTXTexture(GL_TEXTURE_2D, fileName, &info);
+    ASSERT(texLoaded);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    ASSERT_GL();
+
+    glGenTextures(1, &targetTexture);
+    glBindTexture(GL_TEXTURE_2D, targetTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    for (int i = 0; i < cycles; i++)
+    {
+        EGLImageKHR image;
+        EGLNativeSharedImageTypeNOK sharedImage;
+
+        /* Create the image */
+        start = util::getTime();
+        image = eglCreateImageKHR(util::ctx.dpy, util::ctx.context, EGL_GL_TEXTURE_2D_KHR,
+                                  (EGLClientBuffer)(intptr_t)sourceTexture, imageAttributes);
+        totalImageCreation += util::getTime() - start;
+        ASSERT_EGL();
+
+        /* Create the shared image */
+        start = util::getTime();
+        sharedImage = eglCreateSharedImageNOK(util::ctx.dpy, image, sharedImageAttributes);
+        totalSharedImageCreation += util::getTime() - start;
+
+        /* Bind the image to a texture */
+        start = util::getTime();
+        glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+        totalImageBinding += util::getTime() - start;
+
+        /* Draw and read back a single pixel to make sure the texture is fully
+         * prepared
+         */
+        start = util::getTime();
+        glClear(GL_COLOR_BUFFER_BIT);
+        test::drawQuad(0, 0, 1, 1);
+        glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, color);
+        totalRendering += util::getTime() - start;
+
+        /* Prepare for next round */
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, color);
+        eglDestroySharedImageNOK(util::ctx.dpy, sharedImage);
+        eglDestroyImageKHR(util::ctx.dpy, image);
+        test::swapBuffers();
+        ASSERT_GL();
+        ASSERT_EGL();
+    }
+
+    printf("%lld us / %lld us / %lld us / %lld us : ",
+            (long long)(totalImageCreation / cycles / 1000),
+            (long long)(totalSharedImageCreation / cycles / 1000),
+            (long long)(totalImageBinding / cycles / 1000),
+            (long long)(totalRendering / cycles / 1000));
+
+    /* Clean up */
+    glDeleteTextures(1, &targetTexture);
+    glDeleteTextures(1, &sourceTexture);
+}
+
 uint32_t colorAt(int width, int height, int x, int y)
 {
     uint8_t r = (width % 2) * (x ^ y);
@@ -715,6 +1179,13 @@ int main(int argc, char** argv)
     int winHeight = 480;
     int winDepth = 16;
 
+    const char* eglExtensions[] = {"EGL_KHR_image_base", "EGL_NOK_image_shared", NULL};
+
+    if (test::skipUnsupported(eglExtensions, NULL))
+    {
+        return 1;
+    }
+
     EGLNativeDisplayType dpy;
     nativeCreateDisplay(&dpy);
     nativeGetDisplayProperties(dpy, &winWidth, &winHeight, &winDepth);
@@ -738,31 +1209,89 @@ int main(int argc, char** argv)
     ASSERT(result);
     ASSERT_EGL();
 
+    /*
+     * Texture dimensions and formats come from the asset archive. A non-zero
+     * format overrides the one stored in the archive.
+     */
     struct
     {
-        GLint format;
-        GLint type;
         const char* fileName;
+        GLint format;
         uint8_t color[4];
-        int width;
-        int height;
     } entries[] =
     {
-        {GL_RGBA,           GL_UNSIGNED_BYTE,           "blue_64x64_rgba8888.raw", {0x00, 0x00, 0xff, 0xff}, 64,  64},
-        {GL_RGBA,           GL_UNSIGNED_SHORT_4_4_4_4,  "blue_64x64_rgba4444.raw", {0x00, 0x00, 0xff, 0xff}, 64,  64},
-        {GL_RGBA,           GL_UNSIGNED_SHORT_5_5_5_1,  "blue_64x64_rgba1555.raw", {0x00, 0x00, 0xff, 0xff}, 64,  64},
-        {GL_RGB,            GL_UNSIGNED_SHORT_5_6_5,    "blue_64x64_rgb565.raw",   {0x00, 0x00, 0xff, 0xff}, 64,  64},
-        {GL_LUMINANCE,      GL_UNSIGNED_BYTE,           "blue_64x64_r8.raw",       {0x00, 0x00, 0x00, 0xff}, 64,  64},
-        {GL_ALPHA,          GL_UNSIGNED_BYTE,           "blue_64x64_r8.raw",       {0xff, 0x00, 0xff, 0xff}, 64,  64},
-        {GL_ETC1_RGB8_OES,  0,                          "green_64x64_etc1.raw",    {0x00, 0xff, 0x00, 0xff}, 64,  64},
-        {GL_RGBA,           GL_UNSIGNED_BYTE,           "red_113x47_rgba8888.raw", {0xff, 0x00, 0x00, 0xff}, 113, 47},
-        {GL_RGBA,           GL_UNSIGNED_SHORT_4_4_4_4,  "red_113x47_rgba4444.raw", {0xff, 0x00, 0x00, 0xff}, 113, 47},
-        {GL_RGBA,           GL_UNSIGNED_SHORT_5_5_5_1,  "red_113x47_rgba5551.raw", {0xff, 0x00, 0x00, 0xff}, 113, 47},
-        {GL_RGB,            GL_UNSIGNED_SHORT_5_6_5,    "red_113x47_rgb565.raw",   {0xff, 0x00, 0x00, 0xff}, 113, 47},
-        {GL_LUMINANCE,      GL_UNSIGNED_BYTE,           "red_113x47_r8.raw",       {0x00, 0x00, 0x00, 0xff}, 113, 47},
-        {GL_ALPHA,          GL_UNSIGNED_BYTE,           "red_113x47_r8.raw",       {0xff, 0x00, 0xff, 0xff}, 113, 47},
+        {"blue_64x64_rgba8888.raw", 0,          {0x00, 0x00, 0xff, 0xff}},
+        {"blue_64x64_rgba4444.raw", 0,          {0x00, 0x00, 0xff, 0xff}},
+        {"blue_64x64_rgba1555.raw", 0,          {0x00, 0x00, 0xff, 0xff}},
+        {"blue_64x64_rgb565.raw",   0,          {0x00, 0x00, 0xff, 0xff}},
+        {"blue_64x64_r8.raw",       0,          {0x00, 0x00, 0x00, 0xff}},
+        {"blue_64x64_r8.raw",       GL_ALPHA,   {0xff, 0x00, 0xff, 0xff}},
+        {"green_64x64_etc1.raw",    0,          {0x00, 0xff, 0x00, 0xff}},
+        {"red_113x47_rgba8888.raw", 0,          {0xff, 0x00, 0x00, 0xff}},
+        {"red_113x47_rgba4444.raw", 0,          {0xff, 0x00, 0x00, 0xff}},
+        {"red_113x47_rgba5551.raw", 0,          {0xff, 0x00, 0x00, 0xff}},
+        {"red_113x47_rgb565.raw",   0,          {0xff, 0x00, 0x00, 0xff}},
+        {"red_113x47_r8.raw",       0,          {0x00, 0x00, 0x00, 0xff}},
+        {"red_113x47_r8.raw",       GL_ALPHA,   {0xff, 0x00, 0xff, 0xff}},
+    };
+
+    /*
+     * Texture files that util::generateTexture() reproduces. The 113x47 files
+     * split the pattern with a different rounding and are not included.
+     */
+    struct
+    {
+        const char* fileName;
+        GLint format;
+        uint8_t color[4];
+    } matchingAssets[] =
+    {
+        {"blue_64x64_rgba8888.raw", GL_RGBA,            {0x00, 0x00, 0xff, 0xff}},
+        {"blue_64x64_rgba4444.raw", GL_RGBA,            {0x00, 0x00, 0xff, 0xff}},
+        {"blue_64x64_rgba1555.raw", GL_RGBA,            {0x00, 0x00, 0xff, 0xff}},
+        {"blue_64x64_rgb565.raw",   GL_RGB,             {0x00, 0x00, 0xff, 0xff}},
+        {"blue_64x64_r8.raw",       GL_LUMINANCE,       {0x00, 0x00, 0x00, 0xff}},
+        {"green_64x64_etc1.raw",    GL_ETC1_RGB8_OES,   {0x00, 0xff, 0x00, 0xff}},
+    };
+
+    /* Mipmapped textures with a solid color on each level */
+    const uint8_t levelColors[][4] =
+    {
+        {0xff, 0x00, 0x00, 0xff},
+        {0x00, 0xff, 0x00, 0xff},
+        {0x00, 0x00, 0xff, 0xff},
+        {0xff, 0xff, 0x00, 0xff},
+        {0x00, 0xff, 0xff, 0xff},
+        {0xff, 0x00, 0xff, 0xff},
+        {0xff, 0xff, 0xff, 0xff},
+        {0x00, 0x00, 0x00, 0xff},
+    };
+
+    const char* mipmappedTextures[] =
+    {
+        "mipmap_128x128_rgba8888.ktx",
+        "mipmap_128x128_etc1.ktx",
     };
 
+    /* Formats for the generated texture size sweep */
+    struct
+    {
+        GLint format;
+        GLint type;
+        uint8_t color[4];
+    } generatedFormats[] =
+    {
+        {GL_RGBA,           GL_UNSIGNED_BYTE,           {0x00, 0x00, 0xff, 0xff}},
+        {GL_RGB,            GL_UNSIGNED_BYTE,           {0x00, 0x00, 0xff, 0xff}},
+        {GL_RGBA,           GL_UNSIGNED_SHORT_4_4_4_4,  {0x00, 0x00, 0xff, 0xff}},
+        {GL_RGBA,           GL_UNSIGNED_SHORT_5_5_5_1,  {0x00, 0x00, 0xff, 0xff}},
+        {GL_RGB,            GL_UNSIGNED_SHORT_5_6_5,    {0x00, 0x00, 0xff, 0xff}},
+        {GL_LUMINANCE,      GL_UNSIGNED_BYTE,           {0x00, 0x00, 0x00, 0xff}},
+        {GL_ALPHA,          GL_UNSIGNED_BYTE,           {0xff, 0x00, 0xff, 0xff}},
+        {GL_ETC1_RGB8_OES,  0,                          {0x00, 0xff, 0x00, 0xff}},
+    };
+    GLint maxTextureSize = 0;
+
     const int sizes[] = {
         16,
         64,
@@ -773,7 +1302,7 @@ int main(int argc, char** argv)
     };
 
     GLint program = util::createProgram(test::vertSource, test::fragSource);
-    glUseProgram(program);
+    test::useProgram(program);
 
     test::printHeader("Testing extension presence");
     result = test::verifyResult(testExtensionPresence);
@@ -788,30 +1317,94 @@ int main(int argc, char** argv)
 
     for (unsigned int i = 0; i < sizeof(entries) / sizeof(entries[0]); i++)
     {
+        const util::Asset* asset = util::findAsset(entries[i].fileName);
+
+        if (!asset)
+        {
+            test::printHeader("Testing texture %s", entries[i].fileName);
+            test::printResult(false);
+            printf("Asset not found\n");
+            result = false;
+            continue;
+        }
+
+        GLint format = entries[i].format ? entries[i].format : asset->format;
+        GLint type = asset->type;
+
         test::printHeader("Testing texture format %s (%dx%d)",
-                util::textureFormatName(entries[i].format, entries[i].type).c_str(),
-                entries[i].width, entries[i].height);
+                util::textureFormatName(format, type).c_str(),
+                asset->width, asset->height);
         result &= test::verifyResult(
-                boost::bind(testTextures, entries[i].format, entries[i].type, entries[i].width,
-                            entries[i].height, entries[i].fileName, entries[i].color));
+                boost::bind(testTextures, format, type, asset->width,
+                            asset->height, entries[i].fileName, entries[i].color));
         test::swapBuffers();
 
-        if (entries[i].format == GL_ETC1_RGB8_OES ||
-            entries[i].format == GL_ALPHA ||
-            entries[i].format == GL_LUMINANCE)
+        if (format == GL_ETC1_RGB8_OES ||
+            format == GL_ALPHA ||
+            format == GL_LUMINANCE)
         {
             continue;
         }
 
         test::printHeader("Testing framebuffer format %s (%dx%d)",
-                util::textureFormatName(entries[i].format, entries[i].type).c_str(),
-                entries[i].width, entries[i].height);
+                util::textureFormatName(format, type).c_str(),
+                asset->width, asset->height);
         result &= test::verifyResult(
-                boost::bind(testFramebuffers, entries[i].format, entries[i].type, entries[i].width,
-                            entries[i].height, entries[i].color));
+                boost::bind(testFramebuffers, format, type, asset->width,
+                            asset->height, entries[i].color));
         test::swapBuffers();
     }
 
+    for (unsigned int i = 0; i < sizeof(mipmappedTextures) / sizeof(mipmappedTextures[0]); i++)
+    {
+        test::printHeader("Testing mipmapped texture %s", mipmappedTextures[i]);
+        result &= test::verifyResult(
+                boost::bind(testMipmappedTextures, mipmappedTextures[i], levelColors,
+                            sizeof(levelColors) / sizeof(levelColors[0])));
+        test::swapBuffers();
+    }
+
+    for (unsigned int i = 0; i < sizeof(matchingAssets) / sizeof(matchingAssets[0]); i++)
+    {
+        test::printHeader("Testing generated texture against %s",
+                matchingAssets[i].fileName);
+        result &= test::verifyResult(
+                boost::bind(testGeneratedTextureMatchesAsset, matchingAssets[i].fileName,
+                            matchingAssets[i].format, matchingAssets[i].color));
+    }
+
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    for (unsigned int i = 0; i < sizeof(generatedFormats) / sizeof(generatedFormats[0]); i++)
+    {
+        GLint format = generatedFormats[i].format;
+        GLint type = generatedFormats[i].type;
+        bool renderable = (format != GL_ETC1_RGB8_OES &&
+                           format != GL_ALPHA &&
+                           format != GL_LUMINANCE);
+
+        for (int size = 16; size <= 4096 && size <= maxTextureSize; size *= 2)
+        {
+            test::printHeader("Testing generated texture format %s (%dx%d)",
+                    util::textureFormatName(format, type).c_str(), size, size);
+            result &= test::verifyResult(
+                    boost::bind(testGeneratedTextures, format, type, size, size,
+                                generatedFormats[i].color, false));
+            test::swapBuffers();
+
+            if (!renderable)
+            {
+                continue;
+            }
+
+            test::printHeader("Testing generated framebuffer format %s (%dx%d)",
+                    util::textureFormatName(format, type).c_str(), size, size);
+            result &= test::verifyResult(
+                    boost::bind(testGeneratedTextures, format, type, size, size,
+                                generatedFormats[i].color, true));
+            test::swapBuffers();
+        }
+    }
+
     test::printHeader("Running stress test");
     for (unsigned int i = 1; i < 512; i++)
     {
@@ -840,8 +1433,15 @@ int main(int argc, char** argv)
                 boost::bind(testMappingLatency, sizes[i], sizes[i]));
     }
 
+    for (unsigned int i = 0; i < sizeof(mipmappedTextures) / sizeof(mipmappedTextures[0]); i++)
+    {
+        test::printHeader("Testing mipmapped binding latency (%s)", mipmappedTextures[i]);
+        result &= test::verifyResult(
+                boost::bind(testMipmappedMappingLatency, mipmappedTextures[i]));
+    }
+
 out:
-    glDeleteProgram(program);
+    util::destroyProgram(program);
     util::destroyWindow();
 
     printf("================================================\n");
@@ -516,17 +516,19 @@ void testSingleUpdate()
  *  Full update loop:
  *
  *  1. Clear entire screen.
- *  2. Clear a single subrectangle of the screen with another color.
- *  3. Swap the buffer.
+ *  2. Render a frame of @workload, if given.
+ *  3. Clear a single subrectangle of the screen with another color.
+ *  4. Swap the buffer.
  *
  *  Partial update loop:
  *
  *  1. Clear entire screen.
- *  2. Do a partial swap covering the update region.
+ *  2. Render a frame of @workload, if given.
+ *  3. Do a partial swap covering the update region.
  *
  *  The test results include average timings from the two loops above.
  */
-void testSimplePerformance(int width, int height)
+void testSimplePerformance(int width, int height, test::Workload* workload)
 {
     int frames = 256;
     int i;
@@ -543,6 +545,10 @@ void testSimplePerformance(int width, int height)
         glDisable(GL_SCISSOR_TEST);
         glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
+        if (workload)
+        {
+            workload->render(i);
+        }
         glEnable(GL_SCISSOR_TEST);
         glClearColor((float)i / frames, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
@@ -566,6 +572,10 @@ void testSimplePerformance(int width, int height)
     {
         glClearColor(0.0f, (float)i / frames, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT);
+        if (workload)
+        {
+            workload->render(i);
+        }
         eglSwapBuffersRegion2NOK(util::ctx.dpy, util::ctx.surface, 1, rect);
     }
     end = util::getTime();
@@ -640,13 +650,88 @@ void testComplexPerformance(int width, int height)
     ASSERT_GL();
 }
 
+/**
+ *  Run the performance tests on the current window
+ */
+bool runPerformanceTests()
+{
+    bool result = true;
+
+    const EGLint simpleSizes[] =
+    {
+        32, 32,
+        64, 64,
+        256, 256,
+        512, 384,
+        864, 480
+    };
+
+    const EGLint complexSizes[] =
+    {
+        32, 32,
+        64, 64,
+        256, 256,
+    };
+
+    GLint program = util::createProgram(test::vertSource, test::fragSource);
+    test::useProgram(program);
+
+    for (unsigned int i = 0; i < sizeof(simpleSizes) / sizeof(simpleSizes[0]); i += 2)
+    {
+        test::printHeader("Testing %dx%d simple update performance",
+                          simpleSizes[i], simpleSizes[i + 1]);
+        result &= test::verifyResult(boost::bind(testSimplePerformance,
+                    simpleSizes[i], simpleSizes[i + 1], (test::Workload*)NULL));
+    }
+
+    /* Repeat the smallest update with the GPU under load */
+    {
+        test::Workload workload;
+        EGLint surfaceWidth, surfaceHeight;
+
+        eglQuerySurface(util::ctx.dpy, util::ctx.surface, EGL_WIDTH, &surfaceWidth);
+        eglQuerySurface(util::ctx.dpy, util::ctx.surface, EGL_HEIGHT, &surfaceHeight);
+
+        for (int level = test::Workload::Light; level <= test::Workload::Saturated; level++)
+        {
+            test::Workload::Level load = (test::Workload::Level)level;
+
+            workload.calibrate(load, surfaceWidth, surfaceHeight);
+            test::printHeader("Testing %dx%d simple update performance at %s load",
+                              simpleSizes[0], simpleSizes[1],
+                              test::Workload::levelName(load));
+            result &= test::verifyResult(boost::bind(testSimplePerformance,
+                        simpleSizes[0], simpleSizes[1], &workload));
+        }
+    }
+
+    for (unsigned int i = 0; i < sizeof(complexSizes) / sizeof(complexSizes[0]); i += 2)
+    {
+        test::printHeader("Testing %dx%d complex update performance",
+                        complexSizes[i], complexSizes[i + 1]);
+        result &= test::verifyResult(boost::bind(testComplexPerformance,
+                    complexSizes[i], complexSizes[i + 1]));
+    }
+
+    util::destroyProgram(program);
+    return result;
+}
+
 int main(int argc, char** argv)
 {
     bool result;
+    bool extensionPresent;
     int winWidth = 864;
     int winHeight = 480;
     int winDepth = 16;
 
+    const char* eglExtensions[] = {"EGL_NOK_swap_region2", NULL};
+
+    if (test::skipUnsupported(eglExtensions, NULL))
+    {
+        return 1;
+    }
+
     EGLNativeDisplayType dpy;
     nativeCreateDisplay(&dpy);
     nativeGetDisplayProperties(dpy, &winWidth, &winHeight, &winDepth);
@@ -666,31 +751,16 @@ int main(int argc, char** argv)
         EGL_NONE
     };
 
-    const EGLint simpleSizes[] =
-    {
-        32, 32,
-        64, 64,
-        256, 256,
-        512, 384,
-        864, 480
-    };
-
-    const EGLint complexSizes[] =
-    {
-        32, 32,
-        64, 64,
-        256, 256,
-    };
-
     result = util::createWindow(winWidth, winHeight, configAttrs, contextAttrs);
     ASSERT(result);
     ASSERT_EGL();
 
     GLint program = util::createProgram(test::vertSource, test::fragSource);
-    glUseProgram(program);
+    test::useProgram(program);
 
     test::printHeader("Testing extension presence");
     result = test::verifyResult(testExtensionPresence);
+    extensionPresent = result;
 
     if (!result)
     {
@@ -715,26 +785,17 @@ int main(int argc, char** argv)
     test::printHeader("Testing synchronization");
     result &= test::verifyResult(testSynchronization);
 
-    for (unsigned int i = 0; i < sizeof(simpleSizes) / sizeof(simpleSizes[0]); i += 2)
-    {
-        test::printHeader("Testing %dx%d simple update performance",
-                          simpleSizes[i], simpleSizes[i + 1]);
-        result &= test::verifyResult(boost::bind(testSimplePerformance,
-                    simpleSizes[i], simpleSizes[i + 1]));
-    }
+out:
+    util::destroyProgram(program);
+    util::destroyWindow();
 
-    for (unsigned int i = 0; i < sizeof(complexSizes) / sizeof(complexSizes[0]); i += 2)
+    /* Performance depends on the surface format, so measure every config */
+    if (extensionPresent)
     {
-        test::printHeader("Testing %dx%d complex update performance",
-                        complexSizes[i], complexSizes[i + 1]);
-        result &= test::verifyResult(boost::bind(testComplexPerformance,
-                    complexSizes[i], complexSizes[i + 1]));
+        result &= util::runConfigMatrix(winWidth, winHeight, configAttrs, contextAttrs,
+                                        runPerformanceTests);
     }
 
-out:
-    glDeleteProgram(program);
-    util::destroyWindow();
-
     printf("================================================\n");
     printf("Result: ");
     test::printResult(result);
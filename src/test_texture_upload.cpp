@@ -0,0 +1,489 @@
+/**
+ * Texture upload bandwidth test
+ * Copyright (C) 2010 Nokia
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * \author Sami Kyöstilä <sami.kyostila@nokia.com>
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "ext.h"
+#include "native.h"
+#include "util.h"
+#include "testutil.h"
+
+static PFNEGLCREATEIMAGEKHRPROC eglCreateImageKHR;
+static PFNEGLDESTROYIMAGEKHRPROC eglDestroyImageKHR;
+static PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES;
+
+/** Amount of data to upload for each measurement */
+static const size_t bytesPerTest = 64 * 1024 * 1024;
+
+/**
+ * Verify that the extensions needed for pixmap uploads are present
+ */
+void testExtensionPresence()
+{
+    ASSERT(util::isEGLExtensionSupported("EGL_KHR_image_base"));
+    ASSERT(util::isEGLExtensionSupported("EGL_KHR_image_pixmap"));
+
+    eglCreateImageKHR =
+        (PFNEGLCREATEIMAGEKHRPROC)eglGetProcAddress("eglCreateImageKHR");
+    eglDestroyImageKHR =
+        (PFNEGLDESTROYIMAGEKHRPROC)eglGetProcAddress("eglDestroyImageKHR");
+    glEGLImageTargetTexture2DOES =
+        (PFNGLEGLIMAGETARGETTEXTURE2DOESPROC)eglGetProcAddress("glEGLImageTargetTexture2DOES");
+
+    ASSERT(eglCreateImageKHR);
+    ASSERT(eglDestroyImageKHR);
+    ASSERT(glEGLImageTargetTexture2DOES);
+}
+
+/**
+ *  Number of upload cycles needed to transfer roughly bytesPerTest bytes
+ */
+static int cyclesFor(size_t bytes)
+{
+    return std::min(std::max<int>(bytesPerTest / bytes, 8), 1024);
+}
+
+/**
+ *  Draw a single pixel with the bound texture and read it back to make sure
+ *  the texture upload has completed
+ */
+static void finishUpload()
+{
+    uint8_t color[4];
+    test::drawQuad(0, 0, 1, 1);
+    glReadPixels(0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, color);
+}
+
+/**
+ *  Print the transfer rate of @bytes bytes in @time nanoseconds
+ */
+static void printBandwidth(int64_t bytes, int64_t time)
+{
+    printf("%.1f MB/s : ", (bytes / (1024.0 * 1024.0)) / (time / 1e9));
+}
+
+/**
+ *  Generate a test pattern with rows padded to @alignment bytes. Compressed
+ *  data is not padded.
+ *
+ *  @returns the size of the pattern without padding
+ */
+static size_t generatePaddedTexture(GLenum format, GLenum type, int width, int height,
+                                    int alignment, std::vector<uint8_t>& data)
+{
+    const uint8_t color[] = {0x00, 0x00, 0xff, 0xff};
+    std::vector<uint8_t> pixels;
+
+    bool generated = util::generateTexture(format, type, width, height, color, pixels);
+    ASSERT(generated);
+
+    if (type == 0)
+    {
+        data.swap(pixels);
+        return data.size();
+    }
+
+    int rowSize = pixels.size() / height;
+    int pitch = (rowSize + alignment - 1) & ~(alignment - 1);
+
+    data.resize(pitch * height);
+    for (int y = 0; y < height; y++)
+    {
+        memcpy(&data[y * pitch], &pixels[y * rowSize], rowSize);
+    }
+    return pixels.size();
+}
+
+/**
+ *  Measure the bandwidth of full texture uploads.
+ *
+ *  1. Generate a @width x @height test pattern in @format and @type with rows
+ *     padded to @alignment bytes.
+ *  2. Upload the whole texture with glTexImage2D (glCompressedTexImage2D for
+ *     compressed formats) using @alignment as GL_UNPACK_ALIGNMENT.
+ *  3. Draw and read back a single pixel to make sure the upload is complete.
+ *
+ *  The test result is the uploaded data rate, excluding row padding.
+ */
+void testTexImageBandwidth(GLenum format, GLenum type, int width, int height, int alignment)
+{
+    GLuint texture;
+    std::vector<uint8_t> data;
+    bool compressed = (type == 0);
+    size_t bytes = generatePaddedTexture(format, type, width, height, alignment, data);
+    int cycles = cyclesFor(bytes);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    ASSERT_GL();
+
+    int64_t start = util::getTime();
+    for (int i = 0; i < cycles; i++)
+    {
+        if (compressed)
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0,
+                                   data.size(), &data[0]);
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, type, &data[0]);
+        }
+        finishUpload();
+    }
+    int64_t time = util::getTime() - start;
+    ASSERT_GL();
+
+    printBandwidth((int64_t)bytes * cycles, time);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glDeleteTextures(1, &texture);
+}
+
+/**
+ *  Measure the bandwidth of partial texture updates.
+ *
+ *  Initialization:
+ *
+ *  1. Create a @width x @height texture in @format and @type.
+ *  2. Generate a test pattern of half the texture size with rows padded to
+ *     @alignment bytes.
+ *
+ *  Test loop:
+ *
+ *  1. Update the center of the texture with glTexSubImage2D using @alignment
+ *     as GL_UNPACK_ALIGNMENT.
+ *  2. Draw and read back a single pixel to make sure the update is complete.
+ *
+ *  The test result is the updated data rate, excluding row padding.
+ */
+void testTexSubImageBandwidth(GLenum format, GLenum type, int width, int height, int alignment)
+{
+    GLuint texture;
+    std::vector<uint8_t> data;
+    int subWidth = std::max(width / 2, 1);
+    int subHeight = std::max(height / 2, 1);
+
+    size_t bytes = generatePaddedTexture(format, type, subWidth, subHeight, alignment, data);
+    int cycles = cyclesFor(bytes);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, type, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    finishUpload();
+    ASSERT_GL();
+
+    int64_t start = util::getTime();
+    for (int i = 0; i < cycles; i++)
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, width / 4, height / 4, subWidth, subHeight,
+                        format, type, &data[0]);
+        finishUpload();
+    }
+    int64_t time = util::getTime() - start;
+    ASSERT_GL();
+
+    printBandwidth((int64_t)bytes * cycles, time);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glDeleteTextures(1, &texture);
+}
+
+/**
+ *  Measure the bandwidth of texture updates through a pixmap EGLImage.
+ *
+ *  Initialization:
+ *
+ *  1. Create a @width x @height pixmap with color depth @depth.
+ *  2. Create an EGLImage from the pixmap and bind it to a texture.
+ *
+ *  Test loop:
+ *
+ *  1. Upload new contents into the pixmap with XPutImage.
+ *  2. Wait for the native rendering to complete.
+ *  3. Draw and read back a single pixel to make sure the update is visible to
+ *     OpenGL ES.
+ *
+ *  The test result is the uploaded data rate.
+ */
+void testPixmapBandwidth(int width, int height, int depth)
+{
+    EGLNativePixmapType pixmap;
+    EGLImageKHR image;
+    GLuint texture;
+
+    const EGLint imageAttributes[] =
+    {
+        EGL_IMAGE_PRESERVED_KHR, EGL_TRUE,
+        EGL_NONE
+    };
+
+    ASSERT(nativeCreatePixmap(util::ctx.nativeDisplay, depth, width, height, &pixmap));
+
+    image = eglCreateImageKHR(util::ctx.dpy, EGL_NO_CONTEXT, EGL_NATIVE_PIXMAP_KHR,
+                              (EGLClientBuffer)pixmap, imageAttributes);
+    ASSERT_EGL();
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glEGLImageTargetTexture2DOES(GL_TEXTURE_2D, image);
+    ASSERT_GL();
+
+    /* Use an image in the native format of the pixmap */
+    XImage* img = XGetImage(util::ctx.nativeDisplay, pixmap,
+                            0, 0, width, height, -1, ZPixmap);
+    ASSERT(img);
+    memset(img->data, 0x80, img->bytes_per_line * height);
+
+    XGCValues gcValues;
+    GC gc = XCreateGC(util::ctx.nativeDisplay, pixmap, 0, &gcValues);
+
+    size_t bytes = (size_t)width * height * (img->bits_per_pixel / 8);
+    int cycles = cyclesFor(bytes);
+
+    int64_t start = util::getTime();
+    for (int i = 0; i < cycles; i++)
+    {
+        XPutImage(util::ctx.nativeDisplay, pixmap, gc, img, 0, 0, 0, 0, width, height);
+        eglWaitNative(EGL_CORE_NATIVE_ENGINE);
+        finishUpload();
+    }
+    int64_t time = util::getTime() - start;
+
+    printBandwidth((int64_t)bytes * cycles, time);
+
+    /* Clean up */
+    XFreeGC(util::ctx.nativeDisplay, gc);
+    XDestroyImage(img);
+    glDeleteTextures(1, &texture);
+    eglDestroyImageKHR(util::ctx.dpy, image);
+    nativeDestroyPixmap(util::ctx.nativeDisplay, pixmap);
+    ASSERT_GL();
+    ASSERT_EGL();
+}
+
+/**
+ *  Measure the bandwidth of loading a texture from the asset archive.
+ *
+ *  1. Load @fileName with util::loadRawTexture().
+ *  2. Draw and read back a single pixel to make sure the upload is complete.
+ *
+ *  The test result is the uploaded data rate.
+ */
+void testAssetBandwidth(const std::string& fileName)
+{
+    GLuint texture;
+    const util::Asset* asset = util::findAsset(fileName);
+    ASSERT(asset);
+    ASSERT(asset->type);
+
+    /* Raw assets may carry extra data such as a mipmap chain */
+    std::vector<uint8_t> pixels;
+    size_t bytes = generatePaddedTexture(asset->format, asset->type, asset->width,
+                                         asset->height, 1, pixels);
+    int cycles = cyclesFor(bytes);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    int64_t start = util::getTime();
+    for (int i = 0; i < cycles; i++)
+    {
+        bool texLoaded = util::loadRawTexture(GL_TEXTURE_2D, 0, asset->format,
+                                              asset->width, asset->height,
+                                              asset->format, asset->type, fileName);
+        ASSERT(texLoaded);
+        finishUpload();
+    }
+    int64_t time = util::getTime() - start;
+    ASSERT_GL();
+
+    printBandwidth((int64_t)bytes * cycles, time);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glDeleteTextures(1, &texture);
+}
+
+int main(int argc, char** argv)
+{
+    bool result;
+    bool pixmapSupport;
+    int winWidth = 864;
+    int winHeight = 480;
+    int winDepth = 16;
+
+    EGLNativeDisplayType dpy;
+    nativeCreateDisplay(&dpy);
+    nativeGetDisplayProperties(dpy, &winWidth, &winHeight, &winDepth);
+    nativeDestroyDisplay(dpy);
+
+    const EGLint configAttrs[] =
+    {
+        EGL_BUFFER_SIZE,     winDepth,
+        EGL_SURFACE_TYPE,    EGL_WINDOW_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_ES2_BIT,
+        EGL_NONE
+    };
+
+    const EGLint contextAttrs[] =
+    {
+        EGL_CONTEXT_CLIENT_VERSION, 2,
+        EGL_NONE
+    };
+
+    result = util::createWindow(winWidth, winHeight, configAttrs, contextAttrs);
+    ASSERT(result);
+    ASSERT_EGL();
+
+    struct
+    {
+        GLenum format;
+        GLenum type;
+        int pixmapDepth;
+    } formats[] =
+    {
+        {GL_RGBA,           GL_UNSIGNED_BYTE,           32},
+        {GL_RGB,            GL_UNSIGNED_BYTE,           0},
+        {GL_RGBA,           GL_UNSIGNED_SHORT_4_4_4_4,  0},
+        {GL_RGBA,           GL_UNSIGNED_SHORT_5_5_5_1,  0},
+        {GL_RGB,            GL_UNSIGNED_SHORT_5_6_5,    16},
+        {GL_LUMINANCE,      GL_UNSIGNED_BYTE,           0},
+        {GL_ALPHA,          GL_UNSIGNED_BYTE,           0},
+        {GL_ETC1_RGB8_OES,  0,                          0},
+    };
+
+    /* Odd sizes exercise row padding */
+    const struct
+    {
+        int width;
+        int height;
+    } sizes[] =
+    {
+        {64,   64},
+        {113,  47},
+        {256,  256},
+        {854,  480},
+        {1024, 1024},
+    };
+
+    const int alignments[] = {1, 4, 8};
+
+    const char* assets[] =
+    {
+        "blue_64x64_rgba8888.raw",
+        "blue_64x64_rgb565.raw",
+        "red_113x47_rgba8888.raw",
+        "red_113x47_rgb565.raw",
+    };
+
+    GLint program = util::createProgram(test::vertSource, test::fragSource);
+    test::useProgram(program);
+
+    test::printHeader("Testing extension presence");
+    pixmapSupport = test::verifyResult(testExtensionPresence);
+
+    for (unsigned int i = 0; i < sizeof(formats) / sizeof(formats[0]); i++)
+    {
+        GLenum format = formats[i].format;
+        GLenum type = formats[i].type;
+        std::string name = util::textureFormatName(format, type);
+
+        if (format == GL_ETC1_RGB8_OES &&
+            !util::isGLExtensionSupported("GL_OES_compressed_ETC1_RGB8_texture"))
+        {
+            continue;
+        }
+
+        for (unsigned int j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++)
+        {
+            int width = sizes[j].width;
+            int height = sizes[j].height;
+
+            /* Compressed data is uploaded in blocks, so alignment does not apply */
+            if (type == 0)
+            {
+                test::printHeader("Testing glCompressedTexImage2D %s (%dx%d)",
+                        name.c_str(), width, height);
+                result &= test::verifyResult(
+                        boost::bind(testTexImageBandwidth, format, type, width, height, 1));
+                continue;
+            }
+
+            for (unsigned int k = 0; k < sizeof(alignments) / sizeof(alignments[0]); k++)
+            {
+                test::printHeader("Testing glTexImage2D %s (%dx%d, align %d)",
+                        name.c_str(), width, height, alignments[k]);
+                result &= test::verifyResult(
+                        boost::bind(testTexImageBandwidth, format, type, width, height,
+                                    alignments[k]));
+
+                test::printHeader("Testing glTexSubImage2D %s (%dx%d, align %d)",
+                        name.c_str(), width, height, alignments[k]);
+                result &= test::verifyResult(
+                        boost::bind(testTexSubImageBandwidth, format, type, width, height,
+                                    alignments[k]));
+            }
+
+            if (pixmapSupport && formats[i].pixmapDepth)
+            {
+                test::printHeader("Testing XPutImage %s (%dx%d %dbpp pixmap)",
+                        name.c_str(), width, height, formats[i].pixmapDepth);
+                result &= test::verifyResult(
+                        boost::bind(testPixmapBandwidth, width, height,
+                                    formats[i].pixmapDepth));
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < sizeof(assets) / sizeof(assets[0]); i++)
+    {
+        test::printHeader("Testing asset upload %s", assets[i]);
+        result &= test::verifyResult(boost::bind(testAssetBandwidth, assets[i]));
+    }
+
+    util::destroyProgram(program);
+    util::destroyWindow();
+
+    printf("================================================\n");
+    printf("Result: ");
+    test::printResult(result);
+
+    return result ? 0 : 1;
+}
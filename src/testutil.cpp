@@ -15,8 +15,8 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
-#include "testutil.h"
 #include "util.h"
+#include "testutil.h"
 
 #include <stdarg.h>
 #include <stdlib.h>
@@ -25,6 +25,11 @@
 
 #include <sys/mman.h>
 #include <sys/types.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
 
 namespace test
 {
@@ -54,48 +59,484 @@ const char *fragSource =
     "           gl_FragColor = vec4(1.0, 0.0, 1.0, 1.0);\n"
     "}\n";
 
-void drawQuad(int x, int y, int w, int h)
+/**
+ *  GL state of the current context cached by useProgram() and setViewport().
+ *  State that has not been set through them is queried once per context.
+ *  The immediate quad batches are kept per context so that a batch is only
+ *  ever released while the context owning its buffer is current.
+ */
+struct RenderState
 {
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
+    EGLContext context;
+    bool programValid;
     GLint program;
+    GLint positionAttr;
+    GLint texcoordAttr;
+    GLint colorAttr;
+    bool viewportValid;
+    GLint viewport[4];
+    std::map<EGLContext, QuadBatch*> batches;
+};
+
+static pthread_key_t renderStateKey;
+static pthread_once_t renderStateOnce = PTHREAD_ONCE_INIT;
+
+static void destroyRenderState(void* data)
+{
+    RenderState* state = reinterpret_cast<RenderState*>(data);
+    std::map<EGLContext, QuadBatch*>::iterator i;
+
+    for (i = state->batches.begin(); i != state->batches.end(); ++i)
+    {
+        delete i->second;
+    }
+    delete state;
+}
+
+static void createRenderStateKey()
+{
+    pthread_key_create(&renderStateKey, destroyRenderState);
+}
+
+/**
+ *  @returns the cached state of the context current in the calling thread
+ */
+static RenderState& renderState()
+{
+    pthread_once(&renderStateOnce, createRenderStateKey);
+
+    RenderState* state = reinterpret_cast<RenderState*>(pthread_getspecific(renderStateKey));
+    if (!state)
+    {
+        state = new RenderState();
+        pthread_setspecific(renderStateKey, state);
+    }
+
+    EGLContext context = eglGetCurrentContext();
+    if (state->context != context)
+    {
+        state->context = context;
+        state->programValid = false;
+        state->viewportValid = false;
+    }
+    return *state;
+}
 
-    const GLfloat viewW = 0.5f * viewport[2];
-    const GLfloat viewH = 0.5f * viewport[3];
-    const GLfloat texW = 1.0f, texH = 1.0f;
+static void cacheProgram(RenderState& state, GLint program)
+{
+    state.program = program;
+    state.positionAttr = -1;
+    state.texcoordAttr = -1;
+    state.colorAttr = -1;
+    state.programValid = true;
+
+    if (program)
+    {
+        state.positionAttr = glGetAttribLocation(program, "in_position");
+        state.texcoordAttr = glGetAttribLocation(program, "in_texcoord");
+        state.colorAttr = glGetAttribLocation(program, "in_color");
+    }
+}
+
+void useProgram(GLint program)
+{
+    RenderState& state = renderState();
+
+    glUseProgram(program);
+    cacheProgram(state, program);
+}
+
+void setViewport(int x, int y, int width, int height)
+{
+    RenderState& state = renderState();
+
+    glViewport(x, y, width, height);
+    state.viewport[0] = x;
+    state.viewport[1] = y;
+    state.viewport[2] = width;
+    state.viewport[3] = height;
+    state.viewportValid = true;
+}
+
+/**
+ *  Forget the cached state of the current context and release its immediate
+ *  batch. Must be called before a context is destroyed and while it is still
+ *  current, since a new context may reuse its handle and the batch buffer can
+ *  only be deleted in its own context.
+ */
+void resetRenderState()
+{
+    RenderState& state = renderState();
+    std::map<EGLContext, QuadBatch*>::iterator batch = state.batches.find(state.context);
+
+    if (batch != state.batches.end())
+    {
+        delete batch->second;
+        state.batches.erase(batch);
+    }
+    state.programValid = false;
+    state.viewportValid = false;
+}
+
+QuadBatch::QuadBatch():
+    m_buffer(0),
+    m_context(EGL_NO_CONTEXT)
+{
+}
+
+QuadBatch::~QuadBatch()
+{
+    /* The buffer was released along with its context if it is gone */
+    if (m_buffer && eglGetCurrentContext() == m_context)
+    {
+        glDeleteBuffers(1, &m_buffer);
+    }
+}
+
+void QuadBatch::addVertices(int x, int y, int w, int h, const GLfloat* color)
+{
+    RenderState& state = renderState();
+
+    if (!state.viewportValid)
+    {
+        glGetIntegerv(GL_VIEWPORT, state.viewport);
+        state.viewportValid = true;
+    }
+
+    const GLfloat viewW = 0.5f * state.viewport[2];
+    const GLfloat viewH = 0.5f * state.viewport[3];
     const GLfloat quadX1 = x       / viewW - 1.0f, quadY1 = y       / viewH - 1.0f;
     const GLfloat quadX2 = (x + w) / viewW - 1.0f, quadY2 = (y + h) / viewH - 1.0f;
-    const GLfloat texcoords[] =
+
+    /* Two triangles with position, texture coordinates and color */
+    const GLfloat corners[4][4] =
     {
-         0,       texH,
-         0,       0,
-         texW,    texH,
-         texW,    0
+        {quadX1, quadY1, 0.0f, 1.0f},
+        {quadX1, quadY2, 0.0f, 0.0f},
+        {quadX2, quadY1, 1.0f, 1.0f},
+        {quadX2, quadY2, 1.0f, 0.0f},
     };
+    const int order[] = {0, 1, 2, 2, 1, 3};
 
-    const GLfloat vertices[] =
+    for (unsigned int i = 0; i < sizeof(order) / sizeof(order[0]); i++)
     {
-        quadX1, quadY1,
-        quadX1, quadY2,
-        quadX2, quadY1,
-        quadX2, quadY2,
-    };
+        m_vertices.insert(m_vertices.end(), corners[order[i]], corners[order[i]] + 4);
+        m_vertices.insert(m_vertices.end(), color, color + 4);
+    }
+}
+
+void QuadBatch::add(int x, int y, int w, int h)
+{
+    const GLfloat white[] = {1.0f, 1.0f, 1.0f, 1.0f};
+    addVertices(x, y, w, h, white);
+}
+
+void QuadBatch::add(int x, int y, int w, int h, GLfloat r, GLfloat g, GLfloat b)
+{
+    const GLfloat color[] = {r, g, b, 1.0f};
+    addVertices(x, y, w, h, color);
+}
+
+void QuadBatch::flush()
+{
+    const int stride = 8 * sizeof(GLfloat);
+
+    if (m_vertices.empty())
+    {
+        return;
+    }
+
+    RenderState& state = renderState();
+
+    if (!state.programValid)
+    {
+        GLint program;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        cacheProgram(state, program);
+    }
+
+    if (!m_buffer || m_context != state.context)
+    {
+        glGenBuffers(1, &m_buffer);
+        m_context = state.context;
+    }
 
-    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
-    GLint positionAttr = glGetAttribLocation(program, "in_position");
-    GLint texcoordAttr = glGetAttribLocation(program, "in_texcoord");
+    glBindBuffer(GL_ARRAY_BUFFER, m_buffer);
+    glBufferData(GL_ARRAY_BUFFER, m_vertices.size() * sizeof(GLfloat), &m_vertices[0],
+                 GL_STREAM_DRAW);
     ASSERT_GL();
 
-    glVertexAttribPointer(positionAttr, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-    glVertexAttribPointer(texcoordAttr, 2, GL_FLOAT, GL_FALSE, 0, texcoords);
-    glEnableVertexAttribArray(positionAttr);
-    glEnableVertexAttribArray(texcoordAttr);
+    if (state.positionAttr != -1)
+    {
+        glVertexAttribPointer(state.positionAttr, 2, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glEnableVertexAttribArray(state.positionAttr);
+    }
+    if (state.texcoordAttr != -1)
+    {
+        glVertexAttribPointer(state.texcoordAttr, 2, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(2 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(state.texcoordAttr);
+    }
+    if (state.colorAttr != -1)
+    {
+        glVertexAttribPointer(state.colorAttr, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(4 * sizeof(GLfloat)));
+        glEnableVertexAttribArray(state.colorAttr);
+    }
     ASSERT_GL();
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    glDrawArrays(GL_TRIANGLES, 0, m_vertices.size() / 8);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    m_vertices.clear();
     ASSERT_GL();
 }
 
+/**
+ *  @returns the quad batch used by the single quad drawing functions
+ */
+static QuadBatch& immediateBatch()
+{
+    RenderState& state = renderState();
+    QuadBatch*& batch = state.batches[state.context];
+
+    if (!batch)
+    {
+        batch = new QuadBatch();
+    }
+    return *batch;
+}
+
+void drawQuad(int x, int y, int w, int h)
+{
+    QuadBatch& batch = immediateBatch();
+    batch.add(x, y, w, h);
+    batch.flush();
+}
+
+/** Granularity of the workload overdraw as parts of the screen */
+static const int workloadStrips = 16;
+
+Workload::Workload(int aluIterations, int textureFetches):
+    m_aluIterations(aluIterations),
+    m_textureFetches(textureFetches),
+    m_context(EGL_NO_CONTEXT),
+    m_program(0),
+    m_frameUniform(-1),
+    m_texture(0),
+    m_batch(0),
+    m_strips(0),
+    m_width(0),
+    m_height(0),
+    m_targetTime(-1),
+    m_frameTime(0)
+{
+}
+
+Workload::~Workload()
+{
+    destroyResources();
+}
+
+void Workload::createResources()
+{
+    const int textureSize = 64;
+    std::vector<uint32_t> noise(textureSize * textureSize);
+    unsigned int seed = 1;
+    char line[128];
+
+    destroyResources();
+    m_context = eglGetCurrentContext();
+
+    /* Each fetch depends on the previous one and each iteration on the
+     * previous result so that none of the work can be optimized away */
+    std::string source =
+        "precision mediump float;\n"
+        "varying vec2 texcoord;\n"
+        "uniform sampler2D texture;\n"
+        "uniform float frame;\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "   vec4 color = vec4(texcoord, frame, 1.0);\n";
+    for (int i = 0; i < m_textureFetches; i++)
+    {
+        snprintf(line, sizeof(line),
+                 "   color += texture2D(texture, texcoord * %d.0 + color.xy);\n", i + 1);
+        source += line;
+    }
+    for (int i = 0; i < m_aluIterations; i++)
+    {
+        snprintf(line, sizeof(line),
+                 "   color = fract(sin(color * %d.13 + 0.7) * 43.758);\n", i + 1);
+        source += line;
+    }
+    source +=
+        "   gl_FragColor = vec4(color.rgb, 1.0);\n"
+        "}\n";
+
+    m_program = util::createProgram(vertSource, source);
+    m_frameUniform = glGetUniformLocation(m_program, "frame");
+
+    for (unsigned int i = 0; i < noise.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        noise[i] = seed;
+    }
+
+    GLint previousTexture;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, textureSize, textureSize, 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, &noise[0]);
+    glBindTexture(GL_TEXTURE_2D, previousTexture);
+    ASSERT_GL();
+
+    m_batch = new QuadBatch();
+}
+
+void Workload::destroyResources()
+{
+    /* The objects were released along with their context if it is gone.
+     * Otherwise they are left to the context, see the class description. */
+    if (m_context != EGL_NO_CONTEXT && eglGetCurrentContext() == m_context)
+    {
+        delete m_batch;
+        glDeleteTextures(1, &m_texture);
+        util::destroyProgram(m_program);
+    }
+    else if (m_batch)
+    {
+        delete m_batch;
+    }
+    m_batch = 0;
+    m_texture = 0;
+    m_program = 0;
+    m_context = EGL_NO_CONTEXT;
+    m_targetTime = -1;
+}
+
+int64_t Workload::timeFrame()
+{
+    int64_t start = util::getTime();
+    render(0);
+    glFinish();
+    return util::getTime() - start;
+}
+
+void Workload::calibrate(int64_t targetTime, int width, int height)
+{
+    const int maxStrips = 1024 * workloadStrips;
+
+    if (m_context == eglGetCurrentContext() && m_targetTime == targetTime &&
+        m_width == width && m_height == height)
+    {
+        return;
+    }
+
+    if (m_context != eglGetCurrentContext())
+    {
+        createResources();
+    }
+    m_width = width;
+    m_height = height;
+    m_targetTime = targetTime;
+    m_strips = 0;
+    m_frameTime = 0;
+
+    if (!targetTime)
+    {
+        return;
+    }
+
+    /* Keep shader compilation and other first use costs out of the timing */
+    m_strips = 1;
+    timeFrame();
+
+    /* Find the overdraw range containing the target and interpolate */
+    int64_t time = timeFrame();
+    while (time < targetTime && m_strips < maxStrips)
+    {
+        m_strips *= 2;
+        time = timeFrame();
+    }
+    if (time > targetTime)
+    {
+        m_strips = std::max((int)(m_strips * targetTime / time), 1);
+        time = timeFrame();
+    }
+    m_frameTime = time;
+}
+
+void Workload::calibrate(Level level, int width, int height)
+{
+    const int64_t targetTimes[] = {0, 4 * 1000 * 1000, 16 * 1000 * 1000};
+    calibrate(targetTimes[level], width, height);
+}
+
+void Workload::render(int frame)
+{
+    RenderState& state = renderState();
+
+    if (!m_strips)
+    {
+        return;
+    }
+
+    if (!state.programValid)
+    {
+        GLint program;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        cacheProgram(state, program);
+    }
+    GLint previousProgram = state.program;
+    GLint previousTexture;
+    glGetIntegerv(GL_TEXTURE_BINDING_2D, &previousTexture);
+
+    useProgram(m_program);
+    glUniform1f(m_frameUniform, (frame % 16) / 16.0f);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+
+    for (int i = 0; i < m_strips / workloadStrips; i++)
+    {
+        m_batch->add(0, 0, m_width, m_height);
+    }
+    if (m_strips % workloadStrips)
+    {
+        m_batch->add(0, 0, m_width, m_height * (m_strips % workloadStrips) / workloadStrips);
+    }
+    m_batch->flush();
+
+    glBindTexture(GL_TEXTURE_2D, previousTexture);
+    useProgram(previousProgram);
+}
+
+float Workload::overdraw() const
+{
+    return float(m_strips) / workloadStrips;
+}
+
+int64_t Workload::frameTime() const
+{
+    return m_frameTime;
+}
+
+const char* Workload::levelName(Level level)
+{
+    switch (level)
+    {
+    case Idle:
+        return "idle";
+    case Light:
+        return "light";
+    case Saturated:
+        return "saturated";
+    }
+    return "unknown";
+}
+
 namespace color {
 
 const char *vertSource =
@@ -121,43 +562,9 @@ const char *fragSource =
 
 void drawQuad(int x, int y, int w, int h, GLfloat r, GLfloat g, GLfloat b)
 {
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
-    GLint program;
-
-    const GLfloat viewW = 0.5f * viewport[2];
-    const GLfloat viewH = 0.5f * viewport[3];
-    const GLfloat quadX1 = x       / viewW - 1.0f, quadY1 = y       / viewH - 1.0f;
-    const GLfloat quadX2 = (x + w) / viewW - 1.0f, quadY2 = (y + h) / viewH - 1.0f;
-    const GLfloat color[] =
-    {
-        r, g, b, 1.0f,
-        r, g, b, 1.0f,
-        r, g, b, 1.0f,
-        r, g, b, 1.0f,
-    };
-
-    const GLfloat vertices[] =
-    {
-        quadX1, quadY1,
-        quadX1, quadY2,
-        quadX2, quadY1,
-        quadX2, quadY2,
-    };
-
-    glGetIntegerv(GL_CURRENT_PROGRAM, &program);
-    GLint positionAttr = glGetAttribLocation(program, "in_position");
-    GLint colorAttr = glGetAttribLocation(program, "in_color");
-    ASSERT_GL();
-
-    glVertexAttribPointer(positionAttr, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-    glVertexAttribPointer(colorAttr, 4, GL_FLOAT, GL_FALSE, 0, color);
-    glEnableVertexAttribArray(positionAttr);
-    glEnableVertexAttribArray(colorAttr);
-    ASSERT_GL();
-
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    ASSERT_GL();
+    QuadBatch& batch = immediateBatch();
+    batch.add(x, y, w, h, r, g, b);
+    batch.flush();
 }
 
 }
@@ -221,6 +628,48 @@ void printHeader(const char* header, ...)
     fflush(stdout);
 }
 
+/**
+ *  Check for required extensions before creating a window. If an extension
+ *  is known to be missing, the extension presence test is reported as failed
+ *  right away.
+ *
+ *  @returns false if an extension is missing
+ */
+bool verifyCapabilities(const char* const* eglExtensions, const char* const* glExtensions)
+{
+    std::string missing;
+
+    if (util::checkCapabilities(eglExtensions, glExtensions, &missing))
+    {
+        return true;
+    }
+
+    printHeader("Testing extension presence");
+    printResult(false);
+    printf("%s not supported\n", missing.c_str());
+    return false;
+}
+
+/**
+ *  Skip a test program without creating a window if the implementation is
+ *  known to lack the required extensions. The overall result is printed as
+ *  failed.
+ *
+ *  @returns true if the program should exit with a failure status
+ */
+bool skipUnsupported(const char* const* eglExtensions, const char* const* glExtensions)
+{
+    if (verifyCapabilities(eglExtensions, glExtensions))
+    {
+        return false;
+    }
+
+    printf("================================================\n");
+    printf("Result: ");
+    printResult(false);
+    return true;
+}
+
 bool compareRGB565(uint16_t p1, uint16_t p2)
 {
     int r1 = (p1 & 0xf800) >> 11;
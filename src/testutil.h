@@ -28,8 +28,10 @@
 #include <boost/bind.hpp>
 
 #include <GLES2/gl2.h>
+#include <EGL/egl.h>
 
 #include <stdexcept>
+#include <vector>
 
 #define ASSERT(X) \
     do \
@@ -61,12 +63,147 @@ void fail(const char* format, ...);
 bool printResult(bool result);
 bool printResult(const std::runtime_error& error);
 void printHeader(const char* header, ...);
+bool verifyCapabilities(const char* const* eglExtensions, const char* const* glExtensions);
+bool skipUnsupported(const char* const* eglExtensions, const char* const* glExtensions);
 void swapBuffers();
+void useProgram(GLint program);
+void setViewport(int x, int y, int width, int height);
+void resetRenderState();
 void drawQuad(int x, int y, int w, int h);
 bool checkColor(int x, int y, const uint8_t* expected);
 bool compareRGB565(uint16_t p1, uint16_t p2);
 bool compareRGBA8888(uint32_t p1, uint32_t p2);
 
+/**
+ *  Batched quad renderer. Quads are accumulated into a vertex buffer object
+ *  and drawn with a single call when the batch is flushed. The current program
+ *  and viewport are taken from the state cached by useProgram() and
+ *  setViewport(), so drawing does not query GL state once it is known.
+ *
+ *  Textured quads feed the in_texcoord attribute and colored quads the in_color
+ *  attribute of the current program.
+ */
+class QuadBatch
+{
+public:
+    QuadBatch();
+    ~QuadBatch();
+
+    /**
+     *  Add a textured quad to the batch
+     */
+    void add(int x, int y, int w, int h);
+
+    /**
+     *  Add a solid colored quad to the batch
+     */
+    void add(int x, int y, int w, int h, GLfloat r, GLfloat g, GLfloat b);
+
+    /**
+     *  Draw all quads in the batch and empty it
+     */
+    void flush();
+
+private:
+    QuadBatch(const QuadBatch&);
+    QuadBatch& operator=(const QuadBatch&);
+
+    void addVertices(int x, int y, int w, int h, const GLfloat* color);
+
+    std::vector<GLfloat> m_vertices;
+    GLuint m_buffer;
+    EGLContext m_context;
+};
+
+/**
+ *  Generator of GPU work with a predictable duration, used to measure
+ *  latencies under load. A frame of work consists of full screen quads drawn
+ *  with a shader whose per-fragment cost is set by a number of arithmetic
+ *  iterations and texture fetches. The overdraw is calibrated in steps of a
+ *  sixteenth of the screen so that a frame takes a requested time to render.
+ *
+ *  The shader and texture belong to the context current at calibration time.
+ *  Destroy or recalibrate the workload while that context is still current,
+ *  since its objects can only be deleted there; otherwise they are released
+ *  only when the context itself is destroyed. Rendering leaves the current
+ *  program and texture binding unchanged.
+ */
+class Workload
+{
+public:
+    /** Predefined load levels */
+    enum Level
+    {
+        Idle,           /** No work at all */
+        Light,          /** About 4 ms per frame */
+        Saturated       /** About 16 ms per frame, a whole 60 Hz frame */
+    };
+
+    /**
+     *  @param aluIterations    Arithmetic iterations per fragment
+     *  @param textureFetches   Dependent texture fetches per fragment
+     */
+    Workload(int aluIterations = 4, int textureFetches = 2);
+    ~Workload();
+
+    /**
+     *  Pick the overdraw so that rendering a frame into a @width x @height
+     *  viewport takes about @targetTime nanoseconds. Calibration is skipped if
+     *  the workload is already calibrated for the same parameters in the
+     *  current context.
+     */
+    void calibrate(int64_t targetTime, int width, int height);
+
+    /**
+     *  Calibrate for one of the predefined load levels
+     */
+    void calibrate(Level level, int width, int height);
+
+    /**
+     *  Render one frame of work into the current framebuffer. The frame
+     *  number varies the rendering so that consecutive frames differ.
+     */
+    void render(int frame);
+
+    /**
+     *  @returns the overdraw per frame, i.e., the number of times each pixel
+     *  is drawn on average
+     */
+    float overdraw() const;
+
+    /**
+     *  @returns the time a frame took to render during calibration in
+     *  nanoseconds
+     */
+    int64_t frameTime() const;
+
+    /**
+     *  @returns the name of a load level
+     */
+    static const char* levelName(Level level);
+
+private:
+    Workload(const Workload&);
+    Workload& operator=(const Workload&);
+
+    void createResources();
+    void destroyResources();
+    int64_t timeFrame();
+
+    int m_aluIterations;
+    int m_textureFetches;
+    EGLContext m_context;
+    GLint m_program;
+    GLint m_frameUniform;
+    GLuint m_texture;
+    QuadBatch* m_batch;
+    int m_strips;
+    int m_width;
+    int m_height;
+    int64_t m_targetTime;
+    int64_t m_frameTime;
+};
+
 /* Test pattern: four vertical stripes (white, red, green, blue) with lower
  * half with half-intensity */
 template <typename TYPE>
@@ -20,6 +20,7 @@
  */
 #include "util.h"
 #include "native.h"
+#include "assets.h"
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -28,6 +29,15 @@
 #include <string.h>
 #include <fcntl.h>
 #include <stdlib.h>
+#include <math.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <byteswap.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
 
 #include <GLES2/gl2ext.h>
 
@@ -49,8 +59,11 @@ struct Context ctx;
 static osso_context_t* ossoContext;
 #endif
 
-bool loadRawTexture(GLenum target, int level, GLenum internalFormat, int width,
-                    int height, GLenum format, GLenum type, const std::string& fileName)
+/**
+ *  Open a data file from the current directory or the installed data
+ *  directory
+ */
+static int openDataFile(const std::string& fileName)
 {
     int fd = open(fileName.c_str(), O_RDONLY);
 
@@ -58,6 +71,114 @@ bool loadRawTexture(GLenum target, int level, GLenum internalFormat, int width,
     {
         fd = open((std::string(DATA_DIR) + "/" + fileName).c_str(), O_RDONLY);
     }
+    return fd;
+}
+
+/** Packed asset archive, mapped for the lifetime of the process */
+static struct
+{
+    bool initialized;
+    void* data;
+    size_t size;
+    std::map<std::string, Asset> assets;
+} archive;
+
+static void mapAssetArchive()
+{
+    archive.initialized = true;
+
+    int fd = openDataFile(ASSET_ARCHIVE_NAME);
+    if (fd == -1)
+    {
+        fd = openDataFile(std::string("data/") + ASSET_ARCHIVE_NAME);
+    }
+
+    if (fd == -1)
+    {
+        return;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) == -1 || (size_t)sb.st_size < sizeof(AssetArchiveHeader))
+    {
+        close(fd);
+        return;
+    }
+
+    void* data = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        perror("mmap");
+        return;
+    }
+
+    const AssetArchiveHeader* header = (const AssetArchiveHeader*)data;
+    const AssetArchiveEntry* entries = (const AssetArchiveEntry*)(header + 1);
+
+    if (memcmp(header->magic, ASSET_ARCHIVE_MAGIC, sizeof(header->magic)) ||
+        sizeof(*header) + header->entryCount * sizeof(*entries) > (size_t)sb.st_size)
+    {
+        printf("Warning: invalid asset archive\n");
+        munmap(data, sb.st_size);
+        return;
+    }
+
+    for (unsigned i = 0; i < header->entryCount; i++)
+    {
+        const AssetArchiveEntry& entry = entries[i];
+
+        if ((size_t)entry.offset + entry.size > (size_t)sb.st_size)
+        {
+            printf("Warning: truncated asset %.*s\n", ASSET_NAME_LENGTH, entry.name);
+            continue;
+        }
+
+        Asset asset;
+        asset.name = std::string(entry.name, strnlen(entry.name, ASSET_NAME_LENGTH));
+        asset.format = entry.format;
+        asset.type = entry.type;
+        asset.width = entry.width;
+        asset.height = entry.height;
+        asset.data = (const uint8_t*)data + entry.offset;
+        asset.size = entry.size;
+        archive.assets[asset.name] = asset;
+    }
+
+    archive.data = data;
+    archive.size = sb.st_size;
+}
+
+const Asset* findAsset(const std::string& name)
+{
+    if (!archive.initialized)
+    {
+        mapAssetArchive();
+    }
+
+    std::map<std::string, Asset>::const_iterator i = archive.assets.find(name);
+
+    if (i == archive.assets.end())
+    {
+        return NULL;
+    }
+    return &i->second;
+}
+
+bool loadRawTexture(GLenum target, int level, GLenum internalFormat, int width,
+                    int height, GLenum format, GLenum type, const std::string& fileName)
+{
+    const Asset* asset = findAsset(fileName);
+
+    if (asset)
+    {
+        glTexImage2D(target, level, internalFormat, width, height, 0, format, type, asset->data);
+        ASSERT_GL();
+        return true;
+    }
+
+    int fd = openDataFile(fileName);
 
     if (fd == -1)
     {
@@ -85,13 +206,18 @@ bool loadRawTexture(GLenum target, int level, GLenum internalFormat, int width,
 bool loadCompressedTexture(GLenum target, int level, GLenum internalFormat, int width,
                            int height, const std::string& fileName)
 {
-    int fd = open(fileName.c_str(), O_RDONLY);
+    const Asset* asset = findAsset(fileName);
 
-    if (fd == -1)
+    if (asset)
     {
-        fd = open((std::string(DATA_DIR) + "/" + fileName).c_str(), O_RDONLY);
+        glCompressedTexImage2D(target, level, internalFormat, width, height, 0,
+                               asset->size, asset->data);
+        ASSERT_GL();
+        return true;
     }
 
+    int fd = openDataFile(fileName);
+
     if (fd == -1)
     {
         perror("open");
@@ -115,7 +241,624 @@ bool loadCompressedTexture(GLenum target, int level, GLenum internalFormat, int
     return true;
 }
 
-GLint createProgram(const std::string& vertSrc, const std::string& fragSrc)
+/**
+ *  Upload the contents of a KTX file into the currently bound texture
+ */
+static bool uploadKTXTexture(GLenum target, const uint8_t* data, size_t size,
+                             const std::string& fileName, TextureInfo* info)
+{
+    KTXHeader header;
+    uint32_t* fields = &header.endianness;
+    int fieldCount = (sizeof(header) - sizeof(header.identifier)) / sizeof(uint32_t);
+
+    if (size < sizeof(header))
+    {
+        printf("%s: truncated KTX header\n", fileName.c_str());
+        return false;
+    }
+
+    memcpy(&header, data, sizeof(header));
+
+    if (memcmp(header.identifier, KTX_IDENTIFIER, sizeof(header.identifier)))
+    {
+        printf("%s: not a KTX file\n", fileName.c_str());
+        return false;
+    }
+
+    /* Files written with the opposite byte order must be swapped */
+    bool swap = header.endianness != KTX_ENDIANNESS;
+    if (swap)
+    {
+        for (int i = 0; i < fieldCount; i++)
+        {
+            fields[i] = bswap_32(fields[i]);
+        }
+        if (header.endianness != KTX_ENDIANNESS)
+        {
+            printf("%s: invalid KTX endianness\n", fileName.c_str());
+            return false;
+        }
+    }
+
+    if (header.pixelDepth > 1 || header.numberOfArrayElements > 0 ||
+        header.numberOfFaces != 1)
+    {
+        printf("%s: only 2D KTX textures are supported\n", fileName.c_str());
+        return false;
+    }
+
+    bool compressed = (header.glType == 0);
+    int levels = std::max(header.numberOfMipmapLevels, 1u);
+    size_t offset = sizeof(header) + header.bytesOfKeyValueData;
+    std::vector<uint8_t> swapped;
+    GLint alignment;
+
+    /* KTX image rows are padded to four bytes */
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    for (int level = 0; level < levels; level++)
+    {
+        uint32_t imageSize;
+        int width = std::max<int>(header.pixelWidth >> level, 1);
+        int height = std::max<int>(header.pixelHeight >> level, 1);
+
+        if (offset + sizeof(imageSize) > size)
+        {
+            printf("%s: truncated KTX file\n", fileName.c_str());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+            return false;
+        }
+
+        memcpy(&imageSize, data + offset, sizeof(imageSize));
+        offset += sizeof(imageSize);
+        if (swap)
+        {
+            imageSize = bswap_32(imageSize);
+        }
+
+        if (offset + imageSize > size)
+        {
+            printf("%s: truncated KTX file\n", fileName.c_str());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+            return false;
+        }
+
+        const uint8_t* pixels = data + offset;
+
+        if (swap && header.glTypeSize > 1)
+        {
+            swapped.assign(pixels, pixels + imageSize);
+            for (size_t i = 0; i + header.glTypeSize <= imageSize; i += header.glTypeSize)
+            {
+                std::reverse(&swapped[i], &swapped[i + header.glTypeSize]);
+            }
+            pixels = &swapped[0];
+        }
+
+        if (compressed)
+        {
+            glCompressedTexImage2D(target, level, header.glInternalFormat, width, height,
+                                   0, imageSize, pixels);
+        }
+        else
+        {
+            glTexImage2D(target, level, header.glFormat, width, height, 0,
+                         header.glFormat, header.glType, pixels);
+        }
+        offset += (imageSize + 3) & ~3;
+    }
+
+    if (header.numberOfMipmapLevels == 0 && !compressed)
+    {
+        glGenerateMipmap(target);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    ASSERT_GL();
+
+    if (info)
+    {
+        info->format = compressed ? header.glInternalFormat : header.glFormat;
+        info->type = header.glType;
+        info->width = header.pixelWidth;
+        info->height = header.pixelHeight;
+        info->levels = levels;
+    }
+    return true;
+}
+
+bool loadKTXTexture(GLenum target, const std::string& fileName, TextureInfo* info)
+{
+    const Asset* asset = findAsset(fileName);
+
+    if (asset)
+    {
+        return uploadKTXTexture(target, (const uint8_t*)asset->data, asset->size,
+                                fileName, info);
+    }
+
+    int fd = openDataFile(fileName);
+
+    if (fd == -1)
+    {
+        perror("open");
+        return false;
+    }
+
+    struct stat sb;
+    if (fstat(fd, &sb) == -1)
+    {
+        perror("stat");
+        close(fd);
+        return false;
+    }
+
+    void* data = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED)
+    {
+        perror("mmap");
+        return false;
+    }
+
+    bool result = uploadKTXTexture(target, (const uint8_t*)data, sb.st_size, fileName, info);
+    munmap(data, sb.st_size);
+    return result;
+}
+
+/** ETC1 intensity modifier tables */
+static const int etc1Modifiers[8][2] =
+{
+    {2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}
+};
+
+static inline int clampByte(int value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+/**
+ *  Encode a half of an ETC1 block with 4-bit base colors
+ *
+ *  @param block                RGB pixels of the block in row-major order
+ *  @param flip                 Split the block horizontally instead of vertically
+ *  @param half                 Index of the half to encode
+ *  @param[out] base            Base color
+ *  @param[out] table           Modifier table
+ *  @param[out] indices         Pixel indices in ETC1 bit order
+ *
+ *  @returns the squared error of the encoded half
+ */
+static int encodeETC1Half(const uint8_t (*block)[3], bool flip, int half,
+                          int* base, int* table, uint32_t* indices)
+{
+    int pixels[8];
+    int sum[3] = {0, 0, 0};
+
+    for (int i = 0; i < 8; i++)
+    {
+        int x = flip ? (i % 4) : (half * 2 + i / 4);
+        int y = flip ? (half * 2 + i / 4) : (i % 4);
+        pixels[i] = y * 4 + x;
+        for (int c = 0; c < 3; c++)
+        {
+            sum[c] += block[pixels[i]][c];
+        }
+    }
+
+    for (int c = 0; c < 3; c++)
+    {
+        base[c] = (sum[c] * 15 + 8 * 255 / 2) / (8 * 255);
+    }
+
+    int bestError = -1;
+    for (int t = 0; t < 8; t++)
+    {
+        int error = 0;
+        uint32_t tableIndices = 0;
+
+        for (int i = 0; i < 8; i++)
+        {
+            const uint8_t* p = block[pixels[i]];
+            int bestPixelError = -1, bestIndex = 0;
+
+            for (int index = 0; index < 4; index++)
+            {
+                int modifier = etc1Modifiers[t][index & 1] * ((index & 2) ? -1 : 1);
+                int pixelError = 0;
+
+                for (int c = 0; c < 3; c++)
+                {
+                    int d = clampByte(base[c] * 17 + modifier) - p[c];
+                    pixelError += d * d;
+                }
+                if (bestPixelError == -1 || pixelError < bestPixelError)
+                {
+                    bestPixelError = pixelError;
+                    bestIndex = index;
+                }
+            }
+
+            int bit = (pixels[i] % 4) * 4 + pixels[i] / 4;
+            tableIndices |= ((bestIndex >> 1) << (bit + 16)) | ((bestIndex & 1) << bit);
+            error += bestPixelError;
+        }
+
+        if (bestError == -1 || error < bestError)
+        {
+            bestError = error;
+            *table = t;
+            *indices = tableIndices;
+        }
+    }
+    return bestError;
+}
+
+/**
+ *  Encode a 4x4 block of RGB pixels into ETC1 using individual mode
+ */
+static void encodeETC1Block(const uint8_t (*block)[3], uint8_t* out)
+{
+    uint64_t bestCode = 0;
+    int bestError = -1;
+
+    for (int flip = 0; flip < 2; flip++)
+    {
+        int base[2][3], table[2];
+        uint32_t indices[2];
+        int error = encodeETC1Half(block, flip, 0, base[0], &table[0], &indices[0]) +
+                    encodeETC1Half(block, flip, 1, base[1], &table[1], &indices[1]);
+
+        if (bestError != -1 && error >= bestError)
+        {
+            continue;
+        }
+
+        bestError = error;
+        bestCode = ((uint64_t)base[0][0] << 60) | ((uint64_t)base[1][0] << 56) |
+                   ((uint64_t)base[0][1] << 52) | ((uint64_t)base[1][1] << 48) |
+                   ((uint64_t)base[0][2] << 44) | ((uint64_t)base[1][2] << 40) |
+                   ((uint64_t)table[0] << 37) | ((uint64_t)table[1] << 34) |
+                   ((uint64_t)flip << 32) | indices[0] | indices[1];
+    }
+
+    for (int i = 0; i < 8; i++)
+    {
+        out[i] = bestCode >> (56 - i * 8);
+    }
+}
+
+/**
+ *  @returns true if the pixel at (@x, @y) belongs to the white part of the test
+ *  pattern
+ */
+static bool isPatternWhite(int width, int height, int x, int y)
+{
+    bool side = x < width / 4 || x >= width - width / 4;
+
+    if (y < height / 4)
+    {
+        return false;
+    }
+    else if (y < height - height / 4)
+    {
+        return !side;
+    }
+    return side;
+}
+
+bool generateTexture(GLenum format, GLenum type, int width, int height,
+                     const uint8_t* color, std::vector<uint8_t>& data)
+{
+    const uint8_t white[] = {0xff, 0xff, 0xff, 0xff};
+
+    if (format == GL_ETC1_RGB8_OES)
+    {
+        int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        uint8_t block[16][3], previousBlock[16][3];
+
+        data.resize(blocksX * blocksY * 8);
+
+        for (int by = 0; by < blocksY; by++)
+        {
+            for (int bx = 0; bx < blocksX; bx++)
+            {
+                uint8_t* out = &data[(by * blocksX + bx) * 8];
+
+                /* Pixels outside the texture repeat the last row and column */
+                for (int i = 0; i < 16; i++)
+                {
+                    int x = std::min(bx * 4 + i % 4, width - 1);
+                    int y = std::min(by * 4 + i / 4, height - 1);
+                    memcpy(block[i], isPatternWhite(width, height, x, y) ? white : color, 3);
+                }
+
+                /* Most blocks repeat the previous one, so reuse its encoding */
+                if ((bx || by) && !memcmp(block, previousBlock, sizeof(block)))
+                {
+                    memcpy(out, out - 8, 8);
+                    continue;
+                }
+                encodeETC1Block(block, out);
+                memcpy(previousBlock, block, sizeof(block));
+            }
+        }
+        return true;
+    }
+
+    int bytesPerPixel;
+    switch (type)
+    {
+    case GL_UNSIGNED_BYTE:
+        switch (format)
+        {
+        case GL_LUMINANCE:
+        case GL_ALPHA:
+            bytesPerPixel = 1;
+            break;
+        case GL_RGB:
+            bytesPerPixel = 3;
+            break;
+        case GL_RGBA:
+            bytesPerPixel = 4;
+            break;
+        default:
+            return false;
+        }
+        break;
+    case GL_UNSIGNED_SHORT_5_6_5:
+    case GL_UNSIGNED_SHORT_4_4_4_4:
+    case GL_UNSIGNED_SHORT_5_5_5_1:
+        bytesPerPixel = 2;
+        break;
+    default:
+        return false;
+    }
+
+    data.resize(width * height * bytesPerPixel);
+
+    for (int y = 0; y < height; y++)
+    {
+        for (int x = 0; x < width; x++)
+        {
+            const uint8_t* c = isPatternWhite(width, height, x, y) ? white : color;
+            uint8_t* p = &data[(y * width + x) * bytesPerPixel];
+            uint16_t packed;
+
+            switch (type)
+            {
+            case GL_UNSIGNED_SHORT_5_6_5:
+                packed = ((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3);
+                break;
+            case GL_UNSIGNED_SHORT_4_4_4_4:
+                packed = ((c[0] >> 4) << 12) | ((c[1] >> 4) << 8) | ((c[2] >> 4) << 4) | (c[3] >> 4);
+                break;
+            case GL_UNSIGNED_SHORT_5_5_5_1:
+                packed = ((c[0] >> 3) << 11) | ((c[1] >> 3) << 6) | ((c[2] >> 3) << 1) | (c[3] >> 7);
+                break;
+            default:
+                if (bytesPerPixel == 1)
+                {
+                    p[0] = (c == white) ? 0xff : 0x00;
+                }
+                else
+                {
+                    memcpy(p, c, bytesPerPixel);
+                }
+                continue;
+            }
+            memcpy(p, &packed, sizeof(packed));
+        }
+    }
+    return true;
+}
+
+/** Linked program shared by all users of the same sources in a context */
+struct CachedProgram
+{
+    EGLContext context;
+    std::string vertSrc;
+    std::string fragSrc;
+    GLint program;
+    int refCount;
+};
+
+/** In-process program cache */
+static std::vector<CachedProgram> programCache;
+static pthread_mutex_t programCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+static PFNGLGETPROGRAMBINARYOESPROC glGetProgramBinaryOES;
+static PFNGLPROGRAMBINARYOESPROC glProgramBinaryOES;
+
+/**
+ *  Hash a string with the 64-bit FNV-1a algorithm
+ */
+static uint64_t hashString(const std::string& str, uint64_t hash = 0xcbf29ce484222325ull)
+{
+    for (size_t i = 0; i < str.size(); i++)
+    {
+        hash ^= (uint8_t)str[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::string cacheDirectory()
+{
+    const char* dir = getenv("EGLEXT_TESTS_CACHE_DIR");
+
+    if (dir)
+    {
+        return dir;
+    }
+
+    if ((dir = getenv("XDG_CACHE_HOME")) && dir[0])
+    {
+        return std::string(dir) + "/eglext-tests";
+    }
+
+    if ((dir = getenv("HOME")) && dir[0])
+    {
+        return std::string(dir) + "/.cache/eglext-tests";
+    }
+    return "";
+}
+
+/**
+ *  Create a directory and its parents
+ */
+static bool makeDirectory(const std::string& path)
+{
+    for (size_t i = 1; i <= path.size(); i++)
+    {
+        if (i == path.size() || path[i] == '/')
+        {
+            if (mkdir(path.substr(0, i).c_str(), 0755) == -1 && errno != EEXIST)
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/**
+ *  @returns the program binary cache file for a pair of shaders in the current
+ *  context or an empty string if program binaries can not be cached
+ */
+static std::string programBinaryPath(const std::string& vertSrc, const std::string& fragSrc)
+{
+    std::string dir = cacheDirectory();
+
+    if (dir.empty() || !isGLExtensionSupported("GL_OES_get_program_binary"))
+    {
+        return "";
+    }
+
+    if (!glGetProgramBinaryOES)
+    {
+        glGetProgramBinaryOES =
+            (PFNGLGETPROGRAMBINARYOESPROC)eglGetProcAddress("glGetProgramBinaryOES");
+        glProgramBinaryOES =
+            (PFNGLPROGRAMBINARYOESPROC)eglGetProcAddress("glProgramBinaryOES");
+    }
+
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formatCount);
+
+    if (!glGetProgramBinaryOES || !glProgramBinaryOES || !formatCount)
+    {
+        return "";
+    }
+
+    /* Binaries are only valid for the driver that produced them */
+    uint64_t hash = hashString(vertSrc);
+    hash = hashString(fragSrc, hash);
+    hash = hashString((const char*)glGetString(GL_VENDOR), hash);
+    hash = hashString((const char*)glGetString(GL_RENDERER), hash);
+    hash = hashString((const char*)glGetString(GL_VERSION), hash);
+
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)hash);
+    return dir + "/programs" + name;
+}
+
+/**
+ *  Create a program from a cached binary
+ *
+ *  @returns the new program or 0 if the binary is missing or rejected
+ */
+static GLint loadProgramBinary(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+
+    if (fd == -1)
+    {
+        return 0;
+    }
+
+    struct stat sb;
+    uint32_t binaryFormat;
+
+    if (fstat(fd, &sb) == -1 || (size_t)sb.st_size <= sizeof(binaryFormat))
+    {
+        close(fd);
+        return 0;
+    }
+
+    std::vector<uint8_t> data(sb.st_size);
+    bool complete = (read(fd, &data[0], data.size()) == (ssize_t)data.size());
+    close(fd);
+
+    if (!complete)
+    {
+        return 0;
+    }
+
+    memcpy(&binaryFormat, &data[0], sizeof(binaryFormat));
+
+    GLint program = glCreateProgram();
+    GLint success = 0;
+    glProgramBinaryOES(program, binaryFormat, &data[sizeof(binaryFormat)],
+                       data.size() - sizeof(binaryFormat));
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+
+    /* A driver update may invalidate the binary */
+    glGetError();
+    if (!success)
+    {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+/**
+ *  Store the binary of a linked program in the cache
+ */
+static void saveProgramBinary(const std::string& path, GLint program)
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+
+    if (length <= 0 || !makeDirectory(path.substr(0, path.rfind('/'))))
+    {
+        return;
+    }
+
+    GLenum binaryFormat;
+    uint32_t storedFormat;
+    std::vector<uint8_t> data(sizeof(storedFormat) + length);
+    glGetProgramBinaryOES(program, length, &length, &binaryFormat, &data[sizeof(storedFormat)]);
+
+    if (glGetError() != GL_NO_ERROR)
+    {
+        return;
+    }
+
+    storedFormat = binaryFormat;
+    memcpy(&data[0], &storedFormat, sizeof(storedFormat));
+    data.resize(sizeof(storedFormat) + length);
+
+    /* Write to a temporary file first so that readers never see partial data */
+    std::string tempPath = path + ".tmp";
+    FILE* f = fopen(tempPath.c_str(), "wb");
+
+    if (!f)
+    {
+        return;
+    }
+
+    bool written = (fwrite(&data[0], data.size(), 1, f) == 1);
+    if (fclose(f) || !written || rename(tempPath.c_str(), path.c_str()))
+    {
+        unlink(tempPath.c_str());
+    }
+}
+
+static GLint compileProgram(const std::string& vertSrc, const std::string& fragSrc)
 {
     GLint success = 0;
     GLint logLength = 0;
@@ -157,7 +900,99 @@ GLint createProgram(const std::string& vertSrc, const std::string& fragSrc)
     }
     ASSERT(success);
     return program;
-} 
+}
+
+GLint createProgram(const std::string& vertSrc, const std::string& fragSrc)
+{
+    EGLContext context = eglGetCurrentContext();
+
+    pthread_mutex_lock(&programCacheLock);
+    for (size_t i = 0; i < programCache.size(); i++)
+    {
+        CachedProgram& cached = programCache[i];
+
+        if (cached.context == context && cached.vertSrc == vertSrc &&
+            cached.fragSrc == fragSrc)
+        {
+            cached.refCount++;
+            pthread_mutex_unlock(&programCacheLock);
+            return cached.program;
+        }
+    }
+    pthread_mutex_unlock(&programCacheLock);
+
+    std::string binaryPath = programBinaryPath(vertSrc, fragSrc);
+    GLint program = 0;
+
+    if (!binaryPath.empty())
+    {
+        program = loadProgramBinary(binaryPath);
+    }
+
+    if (!program)
+    {
+        program = compileProgram(vertSrc, fragSrc);
+
+        if (!binaryPath.empty())
+        {
+            saveProgramBinary(binaryPath, program);
+        }
+    }
+
+    CachedProgram cached;
+    cached.context = context;
+    cached.vertSrc = vertSrc;
+    cached.fragSrc = fragSrc;
+    cached.program = program;
+    cached.refCount = 1;
+
+    pthread_mutex_lock(&programCacheLock);
+    programCache.push_back(cached);
+    pthread_mutex_unlock(&programCacheLock);
+
+    return program;
+}
+
+void destroyProgram(GLint program)
+{
+    EGLContext context = eglGetCurrentContext();
+
+    pthread_mutex_lock(&programCacheLock);
+    for (size_t i = 0; i < programCache.size(); i++)
+    {
+        if (programCache[i].context == context && programCache[i].program == program)
+        {
+            if (--programCache[i].refCount == 0)
+            {
+                glDeleteProgram(program);
+                programCache.erase(programCache.begin() + i);
+            }
+            pthread_mutex_unlock(&programCacheLock);
+            return;
+        }
+    }
+    pthread_mutex_unlock(&programCacheLock);
+
+    /* Not created through the cache */
+    glDeleteProgram(program);
+}
+
+void forgetPrograms(EGLContext context)
+{
+    pthread_mutex_lock(&programCacheLock);
+    for (size_t i = 0; i < programCache.size();)
+    {
+        if (programCache[i].context == context)
+        {
+            programCache.erase(programCache.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
+    pthread_mutex_unlock(&programCacheLock);
+}
 
 std::string textureFormatName(GLenum format, GLenum type)
 {
@@ -239,140 +1074,530 @@ std::string textureFormatName(GLenum format, GLenum type)
 
 #define C(constant) {#constant, constant}
 
-#define DECLARE_BITFIELD(NAME) \
-    static const struct { const char* name; EGLint value; } NAME[] =
+#define DECLARE_BITFIELD(NAME) \
+    static const struct { const char* name; EGLint value; } NAME[] =
+
+#define B(bit) {#bit, bit}
+
+DECLARE_CONSTANTS(defaultConsts)
+{
+};
+
+DECLARE_BITFIELD(defaultBits)
+{
+};
+
+DECLARE_CONSTANTS(configCaveatConsts)
+{
+    C(EGL_NONE),
+    C(EGL_SLOW_CONFIG),
+    C(EGL_NON_CONFORMANT_CONFIG),
+};
+
+DECLARE_CONSTANTS(transparentTypeConsts)
+{
+    C(EGL_NONE),
+    C(EGL_TRANSPARENT_RGB),
+};
+
+DECLARE_CONSTANTS(colorBufferTypeConsts)
+{
+    C(EGL_NONE),
+    C(EGL_RGB_BUFFER),
+    C(EGL_LUMINANCE_BUFFER),
+};
+
+DECLARE_BITFIELD(surfaceTypeBits)
+{
+    B(EGL_PBUFFER_BIT),
+    B(EGL_PIXMAP_BIT),
+    B(EGL_WINDOW_BIT),
+    B(EGL_VG_COLORSPACE_LINEAR_BIT),
+    B(EGL_VG_ALPHA_FORMAT_PRE_BIT),
+    B(EGL_MULTISAMPLE_RESOLVE_BOX_BIT),
+    B(EGL_SWAP_BEHAVIOR_PRESERVED_BIT),
+};
+
+DECLARE_BITFIELD(renderableTypeBits)
+{
+    B(EGL_OPENGL_ES_BIT),
+    B(EGL_OPENVG_BIT),
+    B(EGL_OPENGL_ES2_BIT),
+    B(EGL_OPENGL_BIT),
+};
+
+#undef C
+#undef DECLARE_CONSTANTS
+#undef B
+#undef DECLARE_BITFIELD
+
+void dumpConfig(EGLDisplay dpy, EGLConfig config)
+{
+    DUMP_CFG_ATTRIB(EGL_BUFFER_SIZE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_ALPHA_SIZE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_BLUE_SIZE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_GREEN_SIZE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_RED_SIZE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_DEPTH_SIZE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_STENCIL_SIZE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_CONFIG_CAVEAT, configCaveatConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_CONFIG_ID, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_LEVEL, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_MAX_PBUFFER_HEIGHT, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_MAX_PBUFFER_PIXELS, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_MAX_PBUFFER_WIDTH, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_NATIVE_RENDERABLE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_NATIVE_VISUAL_ID, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_NATIVE_VISUAL_TYPE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_SAMPLES, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_SAMPLE_BUFFERS, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_SURFACE_TYPE, defaultConsts, surfaceTypeBits);
+    DUMP_CFG_ATTRIB(EGL_TRANSPARENT_TYPE, transparentTypeConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_TRANSPARENT_BLUE_VALUE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_TRANSPARENT_GREEN_VALUE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_TRANSPARENT_RED_VALUE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_BIND_TO_TEXTURE_RGB, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_BIND_TO_TEXTURE_RGBA, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_MIN_SWAP_INTERVAL, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_MAX_SWAP_INTERVAL, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_LUMINANCE_SIZE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_ALPHA_MASK_SIZE, defaultConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_COLOR_BUFFER_TYPE, colorBufferTypeConsts, defaultBits);
+    DUMP_CFG_ATTRIB(EGL_RENDERABLE_TYPE, defaultConsts, renderableTypeBits);
+    DUMP_CFG_ATTRIB(EGL_CONFORMANT, defaultConsts, renderableTypeBits);
+}
+
+#undef DUMP_CFG_ATTRIB
+
+/** Parsed extension string */
+struct ExtensionSet
+{
+    const void* owner;                  /** Display or context of the string */
+    const char* string;                 /** Extension string that was parsed */
+    boost::unordered_set<std::string> names;
+};
+
+static ExtensionSet eglExtensionSet;
+static ExtensionSet glExtensionSet;
+static pthread_mutex_t extensionLock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ *  Split a space separated extension string into a set of names
+ */
+static void parseExtensions(const char* extensions, boost::unordered_set<std::string>& names)
+{
+    names.clear();
+
+    while (extensions && *extensions)
+    {
+        const char* end = strchr(extensions, ' ');
+
+        if (!end)
+        {
+            end = extensions + strlen(extensions);
+        }
+        if (end != extensions)
+        {
+            names.insert(std::string(extensions, end));
+        }
+        extensions = *end ? end + 1 : end;
+    }
+}
+
+/**
+ *  Look up an extension, parsing the extension string only when it has
+ *  changed since the last call
+ */
+static bool isExtensionSupported(ExtensionSet& set, const void* owner,
+                                 const char* extensions, const std::string& name)
+{
+    pthread_mutex_lock(&extensionLock);
+    if (set.owner != owner || set.string != extensions)
+    {
+        parseExtensions(extensions, set.names);
+        set.owner = owner;
+        set.string = extensions;
+    }
+    bool supported = set.names.count(name) > 0;
+    pthread_mutex_unlock(&extensionLock);
+
+    return supported;
+}
+
+bool isEGLExtensionSupported(const std::string& name)
+{
+    return isExtensionSupported(eglExtensionSet, ctx.dpy,
+                                eglQueryString(ctx.dpy, EGL_EXTENSIONS), name);
+}
+
+bool isGLExtensionSupported(const std::string& name)
+{
+    return isExtensionSupported(glExtensionSet, eglGetCurrentContext(),
+                                (const char*)glGetString(GL_EXTENSIONS), name);
+}
+
+#define C(constant) {#constant, constant}
+
+/** Limits recorded in capability snapshots */
+static const struct { const char* name; GLenum value; } glLimitNames[] =
+{
+    C(GL_MAX_TEXTURE_SIZE),
+    C(GL_MAX_CUBE_MAP_TEXTURE_SIZE),
+    C(GL_MAX_RENDERBUFFER_SIZE),
+    C(GL_MAX_TEXTURE_IMAGE_UNITS),
+    C(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS),
+    C(GL_MAX_COMBINED_TEXTURE_IMAGE_UNITS),
+    C(GL_MAX_VERTEX_ATTRIBS),
+    C(GL_MAX_VERTEX_UNIFORM_VECTORS),
+    C(GL_MAX_FRAGMENT_UNIFORM_VECTORS),
+    C(GL_MAX_VARYING_VECTORS),
+    C(GL_NUM_COMPRESSED_TEXTURE_FORMATS),
+    C(GL_NUM_SHADER_BINARY_FORMATS),
+    C(GL_SUBPIXEL_BITS),
+};
+
+/** Config attributes recorded in capability snapshots */
+static const struct { const char* name; EGLint value; } configAttribNames[] =
+{
+    C(EGL_CONFIG_ID),
+    C(EGL_BUFFER_SIZE),
+    C(EGL_RED_SIZE),
+    C(EGL_GREEN_SIZE),
+    C(EGL_BLUE_SIZE),
+    C(EGL_ALPHA_SIZE),
+    C(EGL_DEPTH_SIZE),
+    C(EGL_STENCIL_SIZE),
+    C(EGL_SAMPLES),
+    C(EGL_SAMPLE_BUFFERS),
+    C(EGL_CONFIG_CAVEAT),
+    C(EGL_NATIVE_VISUAL_ID),
+    C(EGL_SURFACE_TYPE),
+    C(EGL_RENDERABLE_TYPE),
+    C(EGL_BIND_TO_TEXTURE_RGBA),
+};
+
+#undef C
+
+/**
+ *  @returns @str or an empty string if @str is NULL
+ */
+static std::string toString(const char* str)
+{
+    return str ? str : "";
+}
+
+void captureCapabilities(Capabilities& caps)
+{
+    caps = Capabilities();
+    caps.eglVendor = toString(eglQueryString(ctx.dpy, EGL_VENDOR));
+    caps.eglVersion = toString(eglQueryString(ctx.dpy, EGL_VERSION));
+    caps.glVendor = toString((const char*)glGetString(GL_VENDOR));
+    caps.glRenderer = toString((const char*)glGetString(GL_RENDERER));
+    caps.glVersion = toString((const char*)glGetString(GL_VERSION));
+    parseExtensions(eglQueryString(ctx.dpy, EGL_EXTENSIONS), caps.eglExtensions);
+    parseExtensions((const char*)glGetString(GL_EXTENSIONS), caps.glExtensions);
+
+    for (unsigned i = 0; i < sizeof(glLimitNames) / sizeof(glLimitNames[0]); i++)
+    {
+        GLint value = 0;
+        glGetIntegerv(glLimitNames[i].value, &value);
+        caps.glLimits[glLimitNames[i].name] = value;
+    }
+    glGetError();
+
+    EGLint configCount = 0;
+    eglGetConfigs(ctx.dpy, NULL, 0, &configCount);
+
+    std::vector<EGLConfig> configs(std::max(configCount, 1));
+    eglGetConfigs(ctx.dpy, &configs[0], configs.size(), &configCount);
+
+    caps.configs.resize(configCount);
+    for (int i = 0; i < configCount; i++)
+    {
+        for (unsigned j = 0; j < sizeof(configAttribNames) / sizeof(configAttribNames[0]); j++)
+        {
+            EGLint value = 0;
+            eglGetConfigAttrib(ctx.dpy, configs[i], configAttribNames[j].value, &value);
+            caps.configs[i][configAttribNames[j].name] = value;
+        }
+    }
+    ASSERT_EGL();
+}
+
+/**
+ *  Write a set of extensions in sorted order
+ */
+static void writeExtensions(FILE* f, const char* key,
+                            const boost::unordered_set<std::string>& names)
+{
+    std::vector<std::string> sorted(names.begin(), names.end());
+    std::sort(sorted.begin(), sorted.end());
+
+    fprintf(f, "%s", key);
+    for (size_t i = 0; i < sorted.size(); i++)
+    {
+        fprintf(f, " %s", sorted[i].c_str());
+    }
+    fprintf(f, "\n");
+}
+
+bool saveCapabilities(const Capabilities& caps, const std::string& fileName)
+{
+    std::string tempName = fileName + ".tmp";
+    FILE* f = fopen(tempName.c_str(), "w");
+
+    if (!f)
+    {
+        return false;
+    }
+
+    fprintf(f, "# eglext-tests capability snapshot\n");
+    fprintf(f, "egl.vendor %s\n", caps.eglVendor.c_str());
+    fprintf(f, "egl.version %s\n", caps.eglVersion.c_str());
+    fprintf(f, "gl.vendor %s\n", caps.glVendor.c_str());
+    fprintf(f, "gl.renderer %s\n", caps.glRenderer.c_str());
+    fprintf(f, "gl.version %s\n", caps.glVersion.c_str());
+    writeExtensions(f, "egl.extensions", caps.eglExtensions);
+    writeExtensions(f, "gl.extensions", caps.glExtensions);
+
+    for (std::map<std::string, GLint>::const_iterator i = caps.glLimits.begin();
+         i != caps.glLimits.end(); ++i)
+    {
+        fprintf(f, "gl.limit %s %d\n", i->first.c_str(), i->second);
+    }
+
+    for (size_t i = 0; i < caps.configs.size(); i++)
+    {
+        fprintf(f, "egl.config");
+        for (std::map<std::string, EGLint>::const_iterator j = caps.configs[i].begin();
+             j != caps.configs[i].end(); ++j)
+        {
+            fprintf(f, " %s=%d", j->first.c_str(), j->second);
+        }
+        fprintf(f, "\n");
+    }
+
+    if (fclose(f) || rename(tempName.c_str(), fileName.c_str()))
+    {
+        unlink(tempName.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadCapabilities(Capabilities& caps, const std::string& fileName)
+{
+    FILE* f = fopen(fileName.c_str(), "r");
+
+    if (!f)
+    {
+        return false;
+    }
+
+    std::string contents;
+    char buffer[4096];
+    size_t count;
+
+    while ((count = fread(buffer, 1, sizeof(buffer), f)) > 0)
+    {
+        contents.append(buffer, count);
+    }
+    fclose(f);
+
+    caps = Capabilities();
+
+    size_t pos = 0;
+    while (pos < contents.size())
+    {
+        size_t end = contents.find('\n', pos);
+        if (end == std::string::npos)
+        {
+            end = contents.size();
+        }
+
+        std::string line = contents.substr(pos, end - pos);
+        size_t sep = line.find(' ');
+        std::string key = line.substr(0, sep);
+        std::string value = (sep == std::string::npos) ? "" : line.substr(sep + 1);
+        pos = end + 1;
+
+        if (key == "egl.vendor")
+        {
+            caps.eglVendor = value;
+        }
+        else if (key == "egl.version")
+        {
+            caps.eglVersion = value;
+        }
+        else if (key == "gl.vendor")
+        {
+            caps.glVendor = value;
+        }
+        else if (key == "gl.renderer")
+        {
+            caps.glRenderer = value;
+        }
+        else if (key == "gl.version")
+        {
+            caps.glVersion = value;
+        }
+        else if (key == "egl.extensions")
+        {
+            parseExtensions(value.c_str(), caps.eglExtensions);
+        }
+        else if (key == "gl.extensions")
+        {
+            parseExtensions(value.c_str(), caps.glExtensions);
+        }
+        else if (key == "gl.limit")
+        {
+            char name[64];
+            GLint limit;
+
+            if (sscanf(value.c_str(), "%63s %d", name, &limit) == 2)
+            {
+                caps.glLimits[name] = limit;
+            }
+        }
+        else if (key == "egl.config")
+        {
+            boost::unordered_set<std::string> attribs;
+            std::map<std::string, EGLint> config;
+
+            parseExtensions(value.c_str(), attribs);
+            for (boost::unordered_set<std::string>::const_iterator i = attribs.begin();
+                 i != attribs.end(); ++i)
+            {
+                size_t eq = i->find('=');
+                if (eq != std::string::npos)
+                {
+                    config[i->substr(0, eq)] = atoi(i->c_str() + eq + 1);
+                }
+            }
+            caps.configs.push_back(config);
+        }
+    }
 
-#define B(bit) {#bit, bit}
+    /* Reject truncated or foreign files */
+    return !caps.eglVendor.empty() && !caps.glRenderer.empty();
+}
 
-DECLARE_CONSTANTS(defaultConsts)
+std::string capabilitiesPath()
 {
-};
+    std::string dir = cacheDirectory();
+    return dir.empty() ? dir : dir + "/capabilities.txt";
+}
 
-DECLARE_BITFIELD(defaultBits)
+/**
+ *  @returns true if a snapshot was taken from the EGL implementation behind
+ *  @dpy and, if @checkGL is set, the OpenGL ES implementation of the current
+ *  context
+ */
+static bool snapshotMatches(const Capabilities& caps, EGLDisplay dpy, bool checkGL)
 {
-};
+    boost::unordered_set<std::string> extensions;
 
-DECLARE_CONSTANTS(configCaveatConsts)
-{
-    C(EGL_NONE),
-    C(EGL_SLOW_CONFIG),
-    C(EGL_NON_CONFORMANT_CONFIG),
-};
+    if (caps.eglVendor != toString(eglQueryString(dpy, EGL_VENDOR)) ||
+        caps.eglVersion != toString(eglQueryString(dpy, EGL_VERSION)))
+    {
+        return false;
+    }
 
-DECLARE_CONSTANTS(transparentTypeConsts)
-{
-    C(EGL_NONE),
-    C(EGL_TRANSPARENT_RGB),
-};
+    parseExtensions(eglQueryString(dpy, EGL_EXTENSIONS), extensions);
+    if (extensions != caps.eglExtensions)
+    {
+        return false;
+    }
 
-DECLARE_CONSTANTS(colorBufferTypeConsts)
-{
-    C(EGL_NONE),
-    C(EGL_RGB_BUFFER),
-    C(EGL_LUMINANCE_BUFFER),
-};
+    if (!checkGL)
+    {
+        return true;
+    }
 
-DECLARE_BITFIELD(surfaceTypeBits)
-{
-    B(EGL_PBUFFER_BIT),
-    B(EGL_PIXMAP_BIT),
-    B(EGL_WINDOW_BIT),
-    B(EGL_VG_COLORSPACE_LINEAR_BIT),
-    B(EGL_VG_ALPHA_FORMAT_PRE_BIT),
-    B(EGL_MULTISAMPLE_RESOLVE_BOX_BIT),
-    B(EGL_SWAP_BEHAVIOR_PRESERVED_BIT),
-};
+    parseExtensions((const char*)glGetString(GL_EXTENSIONS), extensions);
+    return caps.glVendor == toString((const char*)glGetString(GL_VENDOR)) &&
+           caps.glRenderer == toString((const char*)glGetString(GL_RENDERER)) &&
+           caps.glVersion == toString((const char*)glGetString(GL_VERSION)) &&
+           extensions == caps.glExtensions;
+}
 
-DECLARE_BITFIELD(renderableTypeBits)
+/**
+ *  Refresh the capability snapshot from the current context once per process
+ */
+static void updateCapabilities()
 {
-    B(EGL_OPENGL_ES_BIT),
-    B(EGL_OPENVG_BIT),
-    B(EGL_OPENGL_ES2_BIT),
-    B(EGL_OPENGL_BIT),
-};
+    static bool updated;
+    std::string path = capabilitiesPath();
 
-#undef C
-#undef DECLARE_CONSTANTS
-#undef B
-#undef DECLARE_BITFIELD
+    if (updated || path.empty())
+    {
+        return;
+    }
+    updated = true;
 
-void dumpConfig(EGLDisplay dpy, EGLConfig config)
-{
-    DUMP_CFG_ATTRIB(EGL_BUFFER_SIZE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_ALPHA_SIZE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_BLUE_SIZE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_GREEN_SIZE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_RED_SIZE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_DEPTH_SIZE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_STENCIL_SIZE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_CONFIG_CAVEAT, configCaveatConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_CONFIG_ID, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_LEVEL, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_MAX_PBUFFER_HEIGHT, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_MAX_PBUFFER_PIXELS, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_MAX_PBUFFER_WIDTH, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_NATIVE_RENDERABLE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_NATIVE_VISUAL_ID, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_NATIVE_VISUAL_TYPE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_SAMPLES, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_SAMPLE_BUFFERS, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_SURFACE_TYPE, defaultConsts, surfaceTypeBits);
-    DUMP_CFG_ATTRIB(EGL_TRANSPARENT_TYPE, transparentTypeConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_TRANSPARENT_BLUE_VALUE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_TRANSPARENT_GREEN_VALUE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_TRANSPARENT_RED_VALUE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_BIND_TO_TEXTURE_RGB, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_BIND_TO_TEXTURE_RGBA, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_MIN_SWAP_INTERVAL, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_MAX_SWAP_INTERVAL, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_LUMINANCE_SIZE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_ALPHA_MASK_SIZE, defaultConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_COLOR_BUFFER_TYPE, colorBufferTypeConsts, defaultBits);
-    DUMP_CFG_ATTRIB(EGL_RENDERABLE_TYPE, defaultConsts, renderableTypeBits);
-    DUMP_CFG_ATTRIB(EGL_CONFORMANT, defaultConsts, renderableTypeBits);
-}
+    Capabilities caps;
+    if (loadCapabilities(caps, path) && snapshotMatches(caps, ctx.dpy, true))
+    {
+        return;
+    }
 
-#undef DUMP_CFG_ATTRIB
+    captureCapabilities(caps);
+    if (makeDirectory(cacheDirectory()))
+    {
+        saveCapabilities(caps, path);
+    }
+}
 
-/* This is after http://www.opengl.org/resources/features/OGLextensions/ */
-static bool isExtensionSupported(const std::string& extensions, const std::string& name)
+bool checkCapabilities(const char* const* eglExtensions, const char* const* glExtensions,
+                       std::string* missing)
 {
-    const char *start;
-    const char *where, *terminator;
+    EGLNativeDisplayType nativeDisplay;
+    boost::unordered_set<std::string> available;
+    Capabilities caps;
+    std::string path = capabilitiesPath();
+    bool result = true;
 
-    /* Extension names should not have spaces. */
-    where = strchr(name.c_str(), ' ');
-    if (where || !name.size())
+    if (!nativeCreateDisplay(&nativeDisplay))
     {
-        return 0;
+        return true;
     }
 
-    /* It takes a bit of care to be fool-proof about parsing the
-     OpenGL extensions string. Don't be fooled by sub-strings,
-     etc. */
-    start = extensions.c_str();
-    for (;;)
+    EGLDisplay dpy = eglGetDisplay(nativeDisplay);
+    eglInitialize(dpy, NULL, NULL);
+    parseExtensions(eglQueryString(dpy, EGL_EXTENSIONS), available);
+
+    for (; eglExtensions && *eglExtensions && result; eglExtensions++)
     {
-        where = strstr(start, name.c_str());
-        if (!where)
-            break;
-        terminator = where + strlen(name.c_str());
-        if (where == start || *(where - 1) == ' ')
-            if (*terminator == ' ' || *terminator == '\0')
-                return 1;
-        start = terminator;
+        if (!available.count(*eglExtensions))
+        {
+            if (missing)
+            {
+                *missing = *eglExtensions;
+            }
+            result = false;
+        }
     }
-    return 0;
-}
 
-bool isEGLExtensionSupported(const std::string& name)
-{
-    return isExtensionSupported(eglQueryString(ctx.dpy, EGL_EXTENSIONS), name);
-}
+    /* OpenGL ES extensions are only known from a snapshot of this implementation */
+    if (result && glExtensions && !path.empty() &&
+        loadCapabilities(caps, path) && snapshotMatches(caps, dpy, false))
+    {
+        for (; *glExtensions && result; glExtensions++)
+        {
+            if (!caps.glExtensions.count(*glExtensions))
+            {
+                if (missing)
+                {
+                    *missing = *glExtensions;
+                }
+                result = false;
+            }
+        }
+    }
 
-bool isGLExtensionSupported(const std::string& name)
-{
-    return isExtensionSupported((const char*)glGetString(GL_EXTENSIONS), name);
+    eglTerminate(dpy);
+    nativeDestroyDisplay(nativeDisplay);
+    return result;
 }
 
 bool createWindow(int width, int height, const EGLint* configAttrs, const EGLint* contextAttrs)
@@ -436,15 +1661,19 @@ bool createWindow(int width, int height, const EGLint* configAttrs, const EGLint
 
     eglMakeCurrent(ctx.dpy, ctx.surface, ctx.surface, ctx.context);
     ASSERT_EGL();
+
+    updateCapabilities();
     return true;
 
 out_error:
     eglMakeCurrent(ctx.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     eglDestroySurface(ctx.dpy, ctx.surface);
+    forgetPrograms(ctx.context);
     eglDestroyContext(ctx.dpy, ctx.context);
     eglTerminate(ctx.dpy);
     nativeDestroyWindow(ctx.nativeDisplay, ctx.win);
     nativeDestroyDisplay(ctx.nativeDisplay);
+    ctx.nativeDisplay = 0;
     return false;
 }
 
@@ -511,29 +1740,36 @@ bool createPixmap(int width, int height, const EGLint* configAttrs, const EGLint
 
     eglMakeCurrent(ctx.dpy, ctx.surface, ctx.surface, ctx.context);
     ASSERT_EGL();
+
+    updateCapabilities();
     return true;
 
 out_error:
     eglMakeCurrent(ctx.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     eglDestroySurface(ctx.dpy, ctx.surface);
+    forgetPrograms(ctx.context);
     eglDestroyContext(ctx.dpy, ctx.context);
     eglTerminate(ctx.dpy);
     nativeDestroyPixmap(ctx.nativeDisplay, ctx.win);
     nativeDestroyDisplay(ctx.nativeDisplay);
+    ctx.nativeDisplay = 0;
     return false;
 }
 
 void destroyWindow(bool destroyContext)
 {
+    test::resetRenderState();
     eglMakeCurrent(ctx.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     eglDestroySurface(ctx.dpy, ctx.surface);
     if (destroyContext) {
+        forgetPrograms(ctx.context);
         eglDestroyContext(ctx.dpy, ctx.context);
         eglTerminate(ctx.dpy);
     }
     nativeDestroyWindow(ctx.nativeDisplay, ctx.win);
     if (destroyContext) {
         nativeDestroyDisplay(ctx.nativeDisplay);
+        ctx.nativeDisplay = 0;
 
 #if defined(HAVE_LIBOSSO)
         if (ossoContext)
@@ -547,15 +1783,18 @@ void destroyWindow(bool destroyContext)
 
 void destroyPixmap(bool destroyContext)
 {
+    test::resetRenderState();
     eglMakeCurrent(ctx.dpy, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     eglDestroySurface(ctx.dpy, ctx.surface);
     if (destroyContext) {
+        forgetPrograms(ctx.context);
         eglDestroyContext(ctx.dpy, ctx.context);
         eglTerminate(ctx.dpy);
     }
     nativeDestroyPixmap(ctx.nativeDisplay, ctx.pix);
     if (destroyContext) {
         nativeDestroyDisplay(ctx.nativeDisplay);
+        ctx.nativeDisplay = 0;
 
 #if defined(HAVE_LIBOSSO)
         if (ossoContext)
@@ -567,6 +1806,120 @@ void destroyPixmap(bool destroyContext)
     }
 }
 
+std::string describeConfig(EGLDisplay dpy, EGLConfig config)
+{
+    EGLint id = 0, red = 0, green = 0, blue = 0, alpha = 0;
+    EGLint depth = 0, stencil = 0, samples = 0;
+    char desc[128];
+
+    eglGetConfigAttrib(dpy, config, EGL_CONFIG_ID, &id);
+    eglGetConfigAttrib(dpy, config, EGL_RED_SIZE, &red);
+    eglGetConfigAttrib(dpy, config, EGL_GREEN_SIZE, &green);
+    eglGetConfigAttrib(dpy, config, EGL_BLUE_SIZE, &blue);
+    eglGetConfigAttrib(dpy, config, EGL_ALPHA_SIZE, &alpha);
+    eglGetConfigAttrib(dpy, config, EGL_DEPTH_SIZE, &depth);
+    eglGetConfigAttrib(dpy, config, EGL_STENCIL_SIZE, &stencil);
+    eglGetConfigAttrib(dpy, config, EGL_SAMPLES, &samples);
+
+    snprintf(desc, sizeof(desc), "Config %d: R%dG%dB%dA%d, depth %d, stencil %d, %d samples",
+             id, red, green, blue, alpha, depth, stencil, samples);
+    return desc;
+}
+
+bool runConfigMatrix(int width, int height, const EGLint* configAttrs,
+                     const EGLint* contextAttrs, const boost::function<bool ()>& func,
+                     bool pixmap)
+{
+    const char* allConfigs = getenv("EGLEXT_TESTS_ALL_CONFIGS");
+    EGLNativeDisplayType nativeDisplay;
+    EGLint configCount = 0;
+    std::vector<EGLint> configIds;
+    std::vector<std::string> descriptions;
+    bool result = true;
+
+    /* Enumerate the matching configs on a temporary display connection */
+    nativeCreateDisplay(&nativeDisplay);
+    EGLDisplay dpy = eglGetDisplay(nativeDisplay);
+    eglInitialize(dpy, NULL, NULL);
+    eglChooseConfig(dpy, configAttrs, NULL, 0, &configCount);
+
+    std::vector<EGLConfig> configs(std::max(configCount, 1));
+    eglChooseConfig(dpy, configAttrs, &configs[0], configs.size(), &configCount);
+    ASSERT_EGL();
+
+    if (!allConfigs || !atoi(allConfigs))
+    {
+        configCount = std::min(configCount, 1);
+    }
+
+    for (int i = 0; i < configCount; i++)
+    {
+        EGLint id;
+        eglGetConfigAttrib(dpy, configs[i], EGL_CONFIG_ID, &id);
+        configIds.push_back(id);
+        descriptions.push_back(describeConfig(dpy, configs[i]));
+    }
+
+    eglTerminate(dpy);
+    nativeDestroyDisplay(nativeDisplay);
+
+    if (configIds.empty())
+    {
+        printf("Config not found\n");
+        return false;
+    }
+
+    for (size_t i = 0; i < configIds.size(); i++)
+    {
+        /* All other attributes are ignored when EGL_CONFIG_ID is given */
+        const EGLint idAttrs[] =
+        {
+            EGL_CONFIG_ID, configIds[i],
+            EGL_NONE
+        };
+
+        printf("%s\n", descriptions[i].c_str());
+
+        bool created;
+        try
+        {
+            created = pixmap ? createPixmap(width, height, idAttrs, contextAttrs) :
+                               createWindow(width, height, idAttrs, contextAttrs);
+        }
+        catch (const std::runtime_error& e)
+        {
+            printf("Unable to create a surface: %s\n", e.what());
+            created = false;
+        }
+
+        if (!created)
+        {
+            result = false;
+            continue;
+        }
+
+        try
+        {
+            result &= func();
+        }
+        catch (const std::runtime_error& e)
+        {
+            test::printResult(e);
+            result = false;
+        }
+
+        if (pixmap)
+        {
+            destroyPixmap();
+        }
+        else
+        {
+            destroyWindow();
+        }
+    }
+    return result;
+}
+
 int64_t getTime()
 {
     struct timespec t;
@@ -574,4 +1927,170 @@ int64_t getTime()
     return (int64_t)(t.tv_nsec) + (t.tv_sec * 1000ULL * 1000ULL * 1000ULL);
 }
 
+int64_t getCPUTime()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+    return (int64_t)(t.tv_nsec) + (t.tv_sec * 1000ULL * 1000ULL * 1000ULL);
+}
+
+int64_t getThreadCPUTime()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return (int64_t)(t.tv_nsec) + (t.tv_sec * 1000ULL * 1000ULL * 1000ULL);
+}
+
+void Samples::add(int64_t value)
+{
+    m_values.push_back(value);
+}
+
+size_t Samples::count() const
+{
+    return m_values.size();
+}
+
+int64_t Samples::mean() const
+{
+    int64_t sum = 0;
+
+    if (m_values.empty())
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < m_values.size(); i++)
+    {
+        sum += m_values[i];
+    }
+    return sum / (int64_t)m_values.size();
+}
+
+int64_t Samples::min() const
+{
+    return m_values.empty() ? 0 : *std::min_element(m_values.begin(), m_values.end());
+}
+
+int64_t Samples::max() const
+{
+    return m_values.empty() ? 0 : *std::max_element(m_values.begin(), m_values.end());
+}
+
+int64_t Samples::percentile(double p) const
+{
+    if (m_values.empty())
+    {
+        return 0;
+    }
+
+    std::vector<int64_t> sorted(m_values);
+    size_t rank = (size_t)ceil(p / 100.0 * sorted.size());
+    rank = std::min(std::max(rank, (size_t)1), sorted.size());
+
+    std::nth_element(sorted.begin(), sorted.begin() + rank - 1, sorted.end());
+    return sorted[rank - 1];
+}
+
+SyncPool::SyncPool(EGLDisplay dpy, int size):
+    m_dpy(dpy),
+    m_created(0)
+{
+    pthread_mutex_init(&m_lock, NULL);
+
+    m_createSync = (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    m_destroySync = (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    m_signalSync = (PFNEGLSIGNALSYNCKHRPROC)eglGetProcAddress("eglSignalSyncKHR");
+
+    for (int i = 0; i < size && m_createSync; i++)
+    {
+        EGLSyncKHR sync = m_createSync(m_dpy, EGL_SYNC_REUSABLE_KHR, NULL);
+        if (sync == EGL_NO_SYNC_KHR)
+        {
+            break;
+        }
+        m_free.push_back(sync);
+        m_created++;
+    }
+}
+
+SyncPool::~SyncPool()
+{
+    /* Syncs still held by users are left to them */
+    for (size_t i = 0; i < m_free.size(); i++)
+    {
+        m_destroySync(m_dpy, m_free[i]);
+    }
+    pthread_mutex_destroy(&m_lock);
+}
+
+EGLSyncKHR SyncPool::acquire()
+{
+    pthread_mutex_lock(&m_lock);
+    if (!m_free.empty())
+    {
+        EGLSyncKHR sync = m_free.back();
+        m_free.pop_back();
+        pthread_mutex_unlock(&m_lock);
+        return sync;
+    }
+    pthread_mutex_unlock(&m_lock);
+
+    if (!m_createSync)
+    {
+        return EGL_NO_SYNC_KHR;
+    }
+
+    EGLSyncKHR sync = m_createSync(m_dpy, EGL_SYNC_REUSABLE_KHR, NULL);
+    if (sync != EGL_NO_SYNC_KHR)
+    {
+        pthread_mutex_lock(&m_lock);
+        m_created++;
+        pthread_mutex_unlock(&m_lock);
+    }
+    return sync;
+}
+
+void SyncPool::release(EGLSyncKHR sync)
+{
+    m_signalSync(m_dpy, sync, EGL_UNSIGNALED_KHR);
+
+    pthread_mutex_lock(&m_lock);
+    m_free.push_back(sync);
+    pthread_mutex_unlock(&m_lock);
+}
+
+size_t SyncPool::size() const
+{
+    return m_created;
+}
+
+int exportFenceFd(EGLDisplay dpy)
+{
+    static PFNEGLCREATESYNCKHRPROC createSync =
+        (PFNEGLCREATESYNCKHRPROC)eglGetProcAddress("eglCreateSyncKHR");
+    static PFNEGLDESTROYSYNCKHRPROC destroySync =
+        (PFNEGLDESTROYSYNCKHRPROC)eglGetProcAddress("eglDestroySyncKHR");
+    static PFNEGLDUPNATIVEFENCEFDANDROIDPROC dupNativeFenceFD =
+        (PFNEGLDUPNATIVEFENCEFDANDROIDPROC)eglGetProcAddress("eglDupNativeFenceFDANDROID");
+
+    if (!createSync || !destroySync || !dupNativeFenceFD)
+    {
+        return EGL_NO_NATIVE_FENCE_FD_ANDROID;
+    }
+
+    EGLSyncKHR sync = createSync(dpy, EGL_SYNC_NATIVE_FENCE_ANDROID, NULL);
+    if (sync == EGL_NO_SYNC_KHR)
+    {
+        return EGL_NO_NATIVE_FENCE_FD_ANDROID;
+    }
+
+    /* The native fence is created when the fence command is flushed */
+    glFlush();
+
+    int fd = dupNativeFenceFD(dpy, sync);
+    destroySync(dpy, sync);
+    return fd;
+}
+
 } // namespace util
@@ -21,11 +21,18 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <map>
 #include <string>
+#include <vector>
 #include <stdio.h>
+#include <pthread.h>
 #include <GLES2/gl2.h>
 #include <EGL/egl.h>
 
+#include <boost/function.hpp>
+#include <boost/unordered_set.hpp>
+
+#include "ext.h"
 #include "testutil.h"
 
 /**
@@ -109,6 +116,59 @@ void destroyWindow(bool destroyContext = true);
  */
 void destroyPixmap(bool destroyContext = true);
 
+/**
+ *  @returns a one line summary of the color, depth, stencil and sample
+ *  configuration of an EGL config, prefixed with its EGL_CONFIG_ID
+ */
+std::string describeConfig(EGLDisplay dpy, EGLConfig config);
+
+/**
+ *  Run a test once for every EGL config matching @configAttrs. For each
+ *  config a new window (or pixmap) and context is created and made current
+ *  before @func is called, and destroyed afterwards. No rendering surface may
+ *  be current when this is called. A config whose surface cannot be created
+ *  or whose test throws is reported as a failure and the next one is tried.
+ *
+ *  Only the first matching config is used unless the
+ *  EGLEXT_TESTS_ALL_CONFIGS environment variable is set to a non-zero value.
+ *
+ *  @param width        Surface width
+ *  @param height       Surface height
+ *  @param configAttrs  Attributes for config selection
+ *  @param contextAttrs Attributes for context creation
+ *  @param func         Test to run, returning true on success
+ *  @param pixmap       Render to a pixmap instead of a window
+ *
+ *  @returns true if a config was found and the test succeeded on every config
+ */
+bool runConfigMatrix(int width, int height, const EGLint* configAttrs,
+                     const EGLint* contextAttrs, const boost::function<bool ()>& func,
+                     bool pixmap = false);
+
+/**
+ *  Test asset stored in the packed asset archive
+ */
+struct Asset
+{
+    std::string name;   /** File name of the asset */
+    GLenum format;      /** Texture format or 0 if unknown */
+    GLenum type;        /** Texture type, 0 for compressed formats */
+    int width;          /** Width in pixels */
+    int height;         /** Height in pixels */
+    const void* data;   /** Asset contents */
+    size_t size;        /** Size of the contents in bytes */
+};
+
+/**
+ *  Look up an asset from the packed asset archive. The archive is mapped on
+ *  first use and stays mapped for the lifetime of the process.
+ *
+ *  @param name                 Asset file name
+ *
+ *  @returns the asset or NULL if it is not found
+ */
+const Asset* findAsset(const std::string& name);
+
 /**
  *  Load a texture from a binary file
  *
@@ -118,7 +178,8 @@ void destroyPixmap(bool destroyContext = true);
  *  @param width                Texture width in pixels
  *  @param height               Texture height in pixels
  *  @param type                 Data type
- *  @param fileName             File containing the texture data
+ *  @param fileName             File containing the texture data. The asset
+ *                              archive is searched first.
  *
  *  @returns true on success, false on failure
  */
@@ -132,13 +193,57 @@ bool loadRawTexture(GLenum target, int level, GLenum internalFormat, int width,
  *  @param internalFormat       Internal texture format
  *  @param width                Texture width in pixels
  *  @param height               Texture height in pixels
- *  @param fileName             File containing the texture data
+ *  @param fileName             File containing the texture data. The asset
+ *                              archive is searched first.
  *
  *  @returns true on success, false on failure
  */
 bool loadCompressedTexture(GLenum target, int level, GLenum internalFormat, int width,
                            int height, const std::string& fileName);
 
+/**
+ *  Properties of a texture loaded from a container file
+ */
+struct TextureInfo
+{
+    GLenum format;      /** Texture format or compressed internal format */
+    GLenum type;        /** Texture type, 0 for compressed formats */
+    int width;          /** Width of the base level in pixels */
+    int height;         /** Height of the base level in pixels */
+    int levels;         /** Number of mipmap levels loaded */
+};
+
+/**
+ *  Load a texture and all of its mipmap levels from a KTX (version 1) file.
+ *  Uncompressed and ETC1 textures are supported.
+ *
+ *  @param target               Texture target (usually GL_TEXTURE_2D)
+ *  @param fileName             KTX file. The asset archive is searched first.
+ *  @param[out] info            Properties of the loaded texture (optional)
+ *
+ *  @returns true on success, false on failure
+ */
+bool loadKTXTexture(GLenum target, const std::string& fileName, TextureInfo* info = 0);
+
+/**
+ *  Generate a texture with the same test pattern as the texture files in
+ *  data/ in any size. The top quarter of the texture is filled with @color,
+ *  the middle half has a white center and the bottom quarter has white
+ *  corners. Single channel formats use zero instead of @color. ETC1 textures
+ *  are compressed on the CPU. Rows are tightly packed.
+ *
+ *  @param format               Texture format
+ *  @param type                 Texture type, 0 for compressed formats
+ *  @param width                Texture width in pixels
+ *  @param height               Texture height in pixels
+ *  @param color                RGBA color of the pattern
+ *  @param[out] data            Texture data
+ *
+ *  @returns true on success, false if the format is not supported
+ */
+bool generateTexture(GLenum format, GLenum type, int width, int height,
+                     const uint8_t* color, std::vector<uint8_t>& data);
+
 /**
  *  Check whether an EGL extension is supported
  *
@@ -159,15 +264,110 @@ bool isGLExtensionSupported(const std::string& name);
 
 /**
  *  Compile a vertex and fragment shader and create a new program from the
- *  result
+ *  result. Programs are cached: a program already created from the same
+ *  sources in the current context is returned again. Where
+ *  GL_OES_get_program_binary is supported, linked program binaries are also
+ *  stored in cacheDirectory() and reused by later runs.
  *
  *  @param vertSrc              Vertex program source
  *  @param fragSrc              Fragment program source
  *
- *  @returns new program handle
+ *  @returns program handle, to be released with destroyProgram()
  */
 GLint createProgram(const std::string& vertSrc, const std::string& fragSrc);
 
+/**
+ *  Release a program returned by createProgram(). The program is deleted when
+ *  all references to it are released.
+ *
+ *  @param program              Program handle
+ */
+void destroyProgram(GLint program);
+
+/**
+ *  Forget the cached programs of a context. Must be called before the context
+ *  is destroyed, since a new context may reuse its handle and would otherwise
+ *  be handed programs that no longer exist.
+ *
+ *  @param context              Context that is being destroyed
+ */
+void forgetPrograms(EGLContext context);
+
+/**
+ *  @returns the directory for persistent caches. $EGLEXT_TESTS_CACHE_DIR
+ *  overrides the default of $XDG_CACHE_HOME/eglext-tests or
+ *  ~/.cache/eglext-tests. An empty string means caching to disk is
+ *  disabled.
+ */
+std::string cacheDirectory();
+
+/**
+ *  Snapshot of the capabilities of an EGL and OpenGL ES implementation
+ */
+struct Capabilities
+{
+    std::string eglVendor;                          /** EGL_VENDOR */
+    std::string eglVersion;                         /** EGL_VERSION */
+    std::string glVendor;                           /** GL_VENDOR */
+    std::string glRenderer;                         /** GL_RENDERER */
+    std::string glVersion;                          /** GL_VERSION */
+    boost::unordered_set<std::string> eglExtensions;
+    boost::unordered_set<std::string> glExtensions;
+    std::map<std::string, GLint> glLimits;          /** Implementation limits by name */
+    std::vector<std::map<std::string, EGLint> > configs; /** Attributes of every config */
+};
+
+/**
+ *  Capture the capabilities of the current display and context
+ *
+ *  @param caps                 Snapshot to fill in
+ */
+void captureCapabilities(Capabilities& caps);
+
+/**
+ *  Write a capability snapshot to a text file
+ *
+ *  @param caps                 Snapshot to write
+ *  @param fileName             Output file
+ *
+ *  @returns true on success, false on failure
+ */
+bool saveCapabilities(const Capabilities& caps, const std::string& fileName);
+
+/**
+ *  Read a capability snapshot written by saveCapabilities()
+ *
+ *  @param caps                 Snapshot to fill in
+ *  @param fileName             Input file
+ *
+ *  @returns true on success, false on failure
+ */
+bool loadCapabilities(Capabilities& caps, const std::string& fileName);
+
+/**
+ *  @returns the file in cacheDirectory() holding the capability snapshot of
+ *  the last implementation a window or pixmap was created with, or an empty
+ *  string if caching is disabled. The snapshot is refreshed by
+ *  createWindow() and createPixmap() when the implementation changes.
+ */
+std::string capabilitiesPath();
+
+/**
+ *  Check for required extensions before creating a window. EGL extensions
+ *  are queried from the display directly and OpenGL ES extensions are looked
+ *  up from the capability snapshot, if one exists for the current EGL
+ *  implementation.
+ *
+ *  @param eglExtensions        NULL-terminated list of EGL extensions or NULL
+ *  @param glExtensions         NULL-terminated list of OpenGL ES extensions
+ *                              or NULL
+ *  @param missing              Set to the first missing extension
+ *
+ *  @returns false if an extension is known to be missing
+ */
+bool checkCapabilities(const char* const* eglExtensions, const char* const* glExtensions,
+                       std::string* missing = 0);
+
 /**
  *  Describe a texture format and type combination
  *
@@ -189,6 +389,125 @@ void dumpConfig(EGLDisplay dpy, EGLConfig config);
  */
 int64_t getTime();
 
+/**
+ *  @returns the CPU time consumed by all threads of the process in nanoseconds
+ */
+int64_t getCPUTime();
+
+/**
+ *  @returns the CPU time consumed by the calling thread in nanoseconds
+ */
+int64_t getThreadCPUTime();
+
+/**
+ *  A set of measurements, such as latencies in nanoseconds, with summary
+ *  statistics
+ */
+class Samples
+{
+public:
+    /**
+     *  Record a measurement
+     */
+    void add(int64_t value);
+
+    /**
+     *  @returns the number of measurements
+     */
+    size_t count() const;
+
+    /**
+     *  @returns the average of the measurements or 0 if there are none
+     */
+    int64_t mean() const;
+
+    /**
+     *  @returns the smallest measurement or 0 if there are none
+     */
+    int64_t min() const;
+
+    /**
+     *  @returns the largest measurement or 0 if there are none
+     */
+    int64_t max() const;
+
+    /**
+     *  @param p                Percentile in range 0..100
+     *
+     *  @returns the nearest-rank percentile of the measurements or 0 if there
+     *  are none
+     */
+    int64_t percentile(double p) const;
+
+private:
+    std::vector<int64_t> m_values;
+};
+
+/**
+ *  A pool of EGL_KHR_reusable_sync objects. Syncs are created up front and
+ *  returned to the unsignaled state when released, so acquiring one does not
+ *  normally create a new driver object. Reusable syncs are signaled with
+ *  eglSignalSyncKHR rather than by rendering, so the pool is meant for
+ *  signaling between threads, not for tracking rendering completion. The pool
+ *  may be used from several threads.
+ */
+class SyncPool
+{
+public:
+    /**
+     *  @param dpy              EGL display supporting EGL_KHR_reusable_sync
+     *  @param size             Number of syncs to create up front
+     */
+    SyncPool(EGLDisplay dpy, int size);
+    ~SyncPool();
+
+    /**
+     *  @returns an unsignaled sync, or EGL_NO_SYNC_KHR if the pool was empty
+     *  and creating a new sync failed
+     */
+    EGLSyncKHR acquire();
+
+    /**
+     *  Reset a sync acquired from this pool to the unsignaled state and
+     *  return it to the pool
+     */
+    void release(EGLSyncKHR sync);
+
+    /**
+     *  @returns the number of syncs created by the pool
+     */
+    size_t size() const;
+
+private:
+    SyncPool(const SyncPool&);
+    SyncPool& operator=(const SyncPool&);
+
+    EGLDisplay m_dpy;
+    pthread_mutex_t m_lock;
+    std::vector<EGLSyncKHR> m_free;
+    size_t m_created;
+
+    PFNEGLCREATESYNCKHRPROC m_createSync;
+    PFNEGLDESTROYSYNCKHRPROC m_destroySync;
+    PFNEGLSIGNALSYNCKHRPROC m_signalSync;
+};
+
+/**
+ *  Export the completion of the commands issued so far in the current
+ *  context as a sync file. A native fence sync is placed and flushed, its
+ *  file descriptor duplicated and the sync object destroyed. The file
+ *  descriptor becomes readable once the commands have completed and can be
+ *  passed to other processes or imported back with
+ *  EGL_SYNC_NATIVE_FENCE_FD_ANDROID.
+ *
+ *  @param dpy                  EGL display supporting
+ *                              EGL_ANDROID_native_fence_sync
+ *
+ *  @returns a sync file descriptor owned by the caller, or
+ *           EGL_NO_NATIVE_FENCE_FD_ANDROID on failure
+ */
+int exportFenceFd(EGLDisplay dpy);
+
 } // namespace util
 
 #endif // UTIL_H